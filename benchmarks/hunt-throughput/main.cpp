@@ -0,0 +1,642 @@
+#include "j2me-asset-hunter/lib.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <type_traits>
+#include <zlib.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct JarSettings
+    {
+        size_t   entries     = 64;         // Number of zip entries
+        size_t   entrySize   = 256 * 1024; // Uncompressed bytes per entry
+        double   pngsPerMiB  = 8;          // Asset density, per MiB of uncompressed data
+        double   midisPerMiB = 2;
+        double   storedRatio = 0.25; // Share of entries written STORED, the others are deflated
+        double   spanRatio   = 0.1;  // Share of entry boundaries an asset is placed across
+        size_t   midiNotes   = 16;   // Quarter notes per MIDI, at 120 bpm
+        uint64_t seed        = 1;
+    };
+
+    // What went into a generated jar, to check the carve counts against
+    struct JarContents
+    {
+        size_t   pngs          = 0;
+        size_t   midis         = 0;
+        size_t   spanning      = 0;
+        size_t   storedEntries = 0;
+        uint64_t rawBytes      = 0;
+    };
+
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+    {
+        static const auto table = [] {
+            std::array<uint32_t, 256> result {};
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+                result[i] = value;
+            }
+            return result;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Compares the library CRC-32 against zlib for every length up to 3000 bytes, at each alignment of a 16 byte
+    // vector and with the input fed in two chained updates. Only the kernel picked for this CPU is covered
+    bool checkCrc32()
+    {
+        constexpr size_t maxLength  = 3000;
+        constexpr size_t alignments = 16;
+
+        std::mt19937_64            rng(42);
+        std::vector<unsigned char> data(maxLength + alignments);
+        for (auto& byte : data)
+            byte = static_cast<unsigned char>(rng());
+
+        for (size_t align = 0; align < alignments; ++align)
+        {
+            const unsigned char* start = data.data() + align;
+            for (size_t length = 0; length <= maxLength; ++length)
+            {
+                auto expected = static_cast<uint32_t>(crc32_z(0, start, length));
+                if (jhunter::io::crc32(0, start, length) != expected)
+                {
+                    std::fprintf(stderr, "MISMATCH: crc32 of %zu bytes at offset %zu\n", length, align);
+                    return false;
+                }
+
+                size_t split = length / 3;
+                if (jhunter::io::crc32(jhunter::io::crc32(0, start, split), start + split, length - split) != expected)
+                {
+                    std::fprintf(stderr, "MISMATCH: chained crc32 of %zu bytes split at %zu\n", length, split);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Compares the content hash (XXH64, seed 0) against the reference implementation's output, whole and split into
+    // segments at each position, so the streaming path across segment boundaries is covered too
+    bool checkXxh64()
+    {
+        std::string spammish = "Nobody inspects the spammish repetition";
+        std::string longInput;
+        for (int i = 0; i < 4 * 256; ++i)
+            longInput.push_back(static_cast<char>(i));
+        longInput += "xyz";
+
+        const std::pair<std::string, uint64_t> vectors[] = {
+            {"", 0xef46db3751d8e999},
+            {"a", 0xd24ec4f1a98c6e5b},
+            {"abc", 0x44bc2cf5ad770999},
+            {spammish, 0xfbcea83c8a378bf1},
+            {longInput, 0xe146cb31b65bc21a},
+        };
+
+        auto hashOf = [](const std::string& input, std::initializer_list<size_t> splits) {
+            jhunter::io::Buffer buffer(input.begin(), input.end());
+            auto                shared = jhunter::hunter::makeSharedBuffer(std::move(buffer));
+
+            jhunter::hunter::CarvedData data;
+            size_t                      offset = 0;
+            for (size_t split : splits)
+            {
+                data.append(shared, offset, split - offset);
+                offset = split;
+            }
+            data.append(shared, offset, input.size() - offset);
+            return data.contentHash();
+        };
+
+        for (const auto& [input, expected] : vectors)
+        {
+            if (hashOf(input, {}) != expected)
+            {
+                std::fprintf(stderr, "MISMATCH: xxh64 of %zu bytes\n", input.size());
+                return false;
+            }
+            for (size_t split = 1; split < input.size(); ++split)
+            {
+                if (hashOf(input, {split}) != expected || hashOf(input, {split / 2, split}) != expected)
+                {
+                    std::fprintf(stderr, "MISMATCH: xxh64 of %zu bytes split at %zu\n", input.size(), split);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void putBE32(std::vector<char>& out, uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<char>(value >> shift));
+    }
+
+    // Filler that looks like class files and resources: runs of words that deflate well, mixed with noise that
+    // does not. Bytes stay below 0x40 or are lowercase, so no PNG or MIDI signature can show up by chance
+    void fillBytes(std::mt19937_64& rng, char* out, size_t size)
+    {
+        static const char* const words[] = {
+            "java/lang/", "Object", "String", "init", "canvas", "paint", "keyPressed", "sprite", "level", "sound",
+        };
+
+        size_t pos = 0;
+        while (pos < size)
+        {
+            if (rng() % 4 != 0)
+            {
+                const char* word   = words[rng() % std::size(words)];
+                size_t      length = std::min(std::strlen(word), size - pos);
+                for (size_t i = 0; i < length; ++i)
+                    out[pos++] = static_cast<char>(std::tolower(static_cast<unsigned char>(word[i])));
+            }
+            else
+            {
+                size_t length = std::min<size_t>(8 + rng() % 32, size - pos);
+                for (size_t i = 0; i < length; ++i)
+                    out[pos++] = static_cast<char>(rng() & 0x3F);
+            }
+        }
+    }
+
+    void appendPngChunk(std::vector<char>& png, const char* type, const std::vector<char>& data)
+    {
+        putBE32(png, static_cast<uint32_t>(data.size()));
+        size_t typePos = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        putBE32(png, crc32(reinterpret_cast<const unsigned char*>(&png[typePos]), 4 + data.size()));
+    }
+
+    // A PNG with valid chunk CRCs, the IDAT payload is noise of a few KiB
+    std::vector<char> makePng(std::mt19937_64& rng)
+    {
+        std::vector<char> png {'\x89', 'P', 'N', 'G', '\r', '\n', '\x1A', '\n'};
+
+        std::vector<char> header;
+        putBE32(header, 16 + rng() % 64); // Width
+        putBE32(header, 16 + rng() % 64); // Height
+        header.insert(header.end(), {8, 6, 0, 0, 0});
+        appendPngChunk(png, "IHDR", header);
+
+        std::vector<char> pixels(1024 + rng() % (8 * 1024));
+        fillBytes(rng, pixels.data(), pixels.size());
+        appendPngChunk(png, "IDAT", pixels);
+        appendPngChunk(png, "IEND", {});
+        return png;
+    }
+
+    // A format 0 MIDI playing one quarter note after the other
+    std::vector<char> makeMidi(std::mt19937_64& rng, size_t notes)
+    {
+        std::vector<char> track;
+        track.insert(track.end(), {0, '\xFF', 0x51, 3, 0x07, '\xA1', 0x20}); // Tempo: 500000 us per quarter
+        track.insert(track.end(), {0, '\xC0', static_cast<char>(rng() % 128)});
+        for (size_t i = 0; i < notes; ++i)
+        {
+            char key = static_cast<char>(48 + rng() % 24);
+            track.insert(track.end(), {0, '\x90', key, 100});      // Note on
+            track.insert(track.end(), {'\x83', 0x60, '\x80', key, 0}); // 480 ticks later note off
+        }
+        track.insert(track.end(), {0, '\xFF', 0x2F, 0}); // End of track
+
+        std::vector<char> midi {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, '\xE0'}; // 480 ticks per quarter
+        midi.insert(midi.end(), {'M', 'T', 'r', 'k'});
+        putBE32(midi, static_cast<uint32_t>(track.size()));
+        midi.insert(midi.end(), track.begin(), track.end());
+        return midi;
+    }
+
+    // Lay assets out over the concatenated entries, either inside one entry or across the boundary of two, and
+    // cut the result into entries. Hunters see entries back to back, so a split asset is carved as one
+    JarContents generateJar(const std::string& jarPath, const JarSettings& settings)
+    {
+        std::mt19937_64 rng(settings.seed);
+        JarContents     contents;
+
+        uint64_t          totalSize = static_cast<uint64_t>(settings.entries) * settings.entrySize;
+        double            totalMiB  = static_cast<double>(totalSize) / (1024 * 1024);
+        std::vector<char> data(totalSize);
+        fillBytes(rng, data.data(), data.size());
+
+        size_t pngCount   = static_cast<size_t>(settings.pngsPerMiB * totalMiB);
+        size_t assetCount = pngCount + static_cast<size_t>(settings.midisPerMiB * totalMiB);
+        std::bernoulli_distribution span(settings.spanRatio);
+
+        size_t   k   = 0; // Assets made so far
+        uint64_t end = 0; // End of the last placed asset
+        // Place the next asset at pos, or centered on pos when it straddles a boundary, if it fits before limit
+        auto place = [&](uint64_t pos, uint64_t limit, bool straddle) {
+            // PNGs and MIDIs take turns in proportion to their density
+            bool isPng = (k * pngCount) / assetCount != ((k + 1) * pngCount) / assetCount;
+            auto asset = isPng ? makePng(rng) : makeMidi(rng, settings.midiNotes);
+            ++k;
+
+            pos = std::max(end, straddle ? pos - asset.size() / 2 : pos);
+            if (pos + asset.size() > limit)
+                return; // The entry is full
+
+            std::memcpy(&data[pos], asset.data(), asset.size());
+            end = pos + asset.size();
+            ++(isPng ? contents.pngs : contents.midis);
+        };
+
+        // Every entry gets its share of assets spread over it. The last one of an entry may straddle the boundary
+        // to the next entry instead
+        for (size_t i = 0; i < settings.entries; ++i)
+        {
+            uint64_t start = static_cast<uint64_t>(i) * settings.entrySize;
+            size_t   count = assetCount * (i + 1) / settings.entries - assetCount * i / settings.entries;
+            bool     split = count > 0 && i + 1 < settings.entries && span(rng);
+            for (size_t j = 0; j + split < count; ++j)
+                place(start + settings.entrySize * j / count, start + settings.entrySize, false);
+
+            if (split)
+            {
+                uint64_t boundary = start + settings.entrySize;
+                size_t   placed   = contents.pngs + contents.midis;
+                place(boundary, std::min<uint64_t>(boundary + settings.entrySize, totalSize), true);
+                if (contents.pngs + contents.midis > placed && end > boundary)
+                    ++contents.spanning;
+            }
+        }
+
+        int    error = 0;
+        zip_t* zip   = zip_open(jarPath.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &error);
+        if (!zip)
+        {
+            std::cerr << "Error: Failed to create jar: " << jarPath << std::endl;
+            throw std::runtime_error("Failed to create jar.");
+        }
+
+        // libzip reads the sources on zip_close, data outlives it
+        std::bernoulli_distribution stored(settings.storedRatio);
+        for (size_t i = 0; i < settings.entries; ++i)
+        {
+            std::string    name   = "res/" + std::to_string(i) + ".bin";
+            zip_source_t*  source = zip_source_buffer(zip, &data[i * settings.entrySize], settings.entrySize, 0);
+            zip_int64_t    index  = source ? zip_file_add(zip, name.c_str(), source, ZIP_FL_OVERWRITE) : -1;
+            bool           store  = stored(rng);
+            if (index < 0 || zip_set_file_compression(zip, index, store ? ZIP_CM_STORE : ZIP_CM_DEFLATE, 0) < 0)
+            {
+                if (source && index < 0)
+                    zip_source_free(source);
+                zip_discard(zip);
+                std::cerr << "Error: Failed to add entry to jar: " << name << std::endl;
+                throw std::runtime_error("Failed to add entry to jar.");
+            }
+            contents.storedEntries += store;
+        }
+
+        if (zip_close(zip) < 0)
+        {
+            std::cerr << "Error: Failed to write jar: " << zip_strerror(zip) << std::endl;
+            zip_discard(zip);
+            throw std::runtime_error("Failed to write jar.");
+        }
+
+        contents.rawBytes = totalSize;
+        return contents;
+    }
+
+    // Repeat a pass until enough time has elapsed, returns MB/s over bytes per pass and the result of the last one
+    template<typename PassFunc>
+    auto measurePasses(uint64_t bytes, double minSeconds, PassFunc&& pass)
+    {
+        size_t iterations = 0;
+        auto   start      = Clock::now();
+        auto   elapsed    = std::chrono::duration<double>(0);
+        auto   result     = pass();
+        do
+        {
+            if (iterations > 0)
+                result = pass();
+            ++iterations;
+            elapsed = Clock::now() - start;
+        } while (elapsed.count() < minSeconds);
+
+        double megabytes = static_cast<double>(bytes) * iterations / (1024.0 * 1024.0);
+        return std::make_pair(megabytes / elapsed.count(), std::move(result));
+    }
+
+    // Keeps nothing, counts what a render would have written
+    class NullSink : public jhunter::hunter::OutputSink
+    {
+    public:
+        NullSink() : OutputSink(false) {}
+
+        uint64_t getWavBytes() const { return m_WavBytes; }
+
+    protected:
+        void store(const std::filesystem::path& path, const jhunter::hunter::CarvedData& data) override
+        {
+            if (path.extension() == ".wav")
+                m_WavBytes += data.size();
+        }
+
+    private:
+        std::atomic<uint64_t> m_WavBytes {0};
+    };
+
+    // Results in a flat list, printed as a table and optionally as JSON to diff between versions
+    struct Report
+    {
+        std::vector<std::pair<std::string, std::string>> config;
+        std::vector<std::pair<std::string, double>>      results;
+
+        void addConfig(const std::string& name, const std::string& value) { config.emplace_back(name, value); }
+        void add(const std::string& name, double value) { results.emplace_back(name, value); }
+
+        void print() const
+        {
+            for (const auto& [name, value] : config)
+                std::printf("%-24s %s\n", name.c_str(), value.c_str());
+            std::printf("\n");
+            for (const auto& [name, value] : results)
+                std::printf("%-24s %14.2f\n", name.c_str(), value);
+        }
+
+        void writeJson(std::FILE* out) const
+        {
+            std::fprintf(out, "{\n  \"benchmark\": \"hunt-throughput\",\n  \"config\": {");
+            for (size_t i = 0; i < config.size(); ++i)
+            {
+                const auto& [name, value] = config[i];
+                std::fprintf(out, "%s\n    \"%s\": \"%s\"", i ? "," : "", name.c_str(), value.c_str());
+            }
+            std::fprintf(out, "\n  },\n  \"results\": {");
+            for (size_t i = 0; i < results.size(); ++i)
+                std::fprintf(out, "%s\n    \"%s\": %.3f", i ? "," : "", results[i].first.c_str(), results[i].second);
+            std::fprintf(out, "\n  }\n}\n");
+        }
+    };
+
+    std::string formatNumber(double value)
+    {
+        std::ostringstream stream;
+        stream << value;
+        return stream.str();
+    }
+
+    // Let a hunter parse the buffers once, for the counts and for timing
+    template<typename Hunter, typename Settings = std::nullptr_t>
+    size_t carve(const std::vector<jhunter::hunter::SharedBuffer>& buffers, const Settings& settings = nullptr)
+    {
+        Hunter hunter;
+        if constexpr (!std::is_same_v<Settings, std::nullptr_t>)
+            hunter.setSettings(settings);
+        for (const auto& buffer : buffers)
+            hunter.addSourceBuffer(buffer);
+        return hunter.parseFiles().size();
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto workingDir = std::filesystem::path(argv[0]).parent_path();
+
+    argparse::ArgumentParser program("hunt-throughput");
+    program.add_argument("--entries")
+        .help("the number of entries of the generated jar.")
+        .default_value(64)
+        .scan<'i', int>();
+    program.add_argument("--entry-size")
+        .help("the uncompressed size of an entry in KiB.")
+        .default_value(256)
+        .scan<'i', int>();
+    program.add_argument("--pngs").help("PNGs per MiB of uncompressed data.").default_value(8.0).scan<'g', double>();
+    program.add_argument("--midis").help("MIDIs per MiB of uncompressed data.").default_value(2.0).scan<'g', double>();
+    program.add_argument("--stored")
+        .help("the share of STORED entries, 0 to 1.")
+        .default_value(0.25)
+        .scan<'g', double>();
+    program.add_argument("--span")
+        .help("the share of entry boundaries an asset is split over, 0 to 1.")
+        .default_value(0.1)
+        .scan<'g', double>();
+    program.add_argument("--seed").help("the seed of the generated content.").default_value(1).scan<'i', int>();
+    program.add_argument("-j", "--jobs")
+        .help("the number of threads, 0 for all cores.")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--renders")
+        .help("the number of MIDIs rendered to WAV, 0 to skip rendering.")
+        .default_value(8)
+        .scan<'i', int>();
+    program.add_argument("--min-time")
+        .help("the minimum seconds each measurement runs for.")
+        .default_value(0.5)
+        .scan<'g', double>();
+    program.add_argument("--jar").help("keep the generated jar at this path.").default_value("");
+    program.add_argument("--json").help("also write the results as JSON to this file, - for stdout.").default_value("");
+
+    try
+    {
+        program.parse_args(argc, argv);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << std::endl;
+        std::cerr << program;
+        return 1;
+    }
+
+    JarSettings jarSettings;
+    jarSettings.entries     = static_cast<size_t>(std::max(program.get<int>("--entries"), 1));
+    jarSettings.entrySize   = static_cast<size_t>(std::max(program.get<int>("--entry-size"), 1)) * 1024;
+    jarSettings.pngsPerMiB  = std::max(program.get<double>("--pngs"), 0.0);
+    jarSettings.midisPerMiB = std::max(program.get<double>("--midis"), 0.0);
+    jarSettings.storedRatio = std::clamp(program.get<double>("--stored"), 0.0, 1.0);
+    jarSettings.spanRatio   = std::clamp(program.get<double>("--span"), 0.0, 1.0);
+    jarSettings.seed        = static_cast<uint64_t>(program.get<int>("--seed"));
+
+    size_t jobs = std::max(program.get<int>("--jobs"), 0);
+    if (jobs == 0)
+        jobs = std::max(std::thread::hardware_concurrency(), 1u);
+
+    size_t renders = std::max(program.get<int>("--renders"), 0);
+    double minTime = std::max(program.get<double>("--min-time"), 0.0);
+
+    bool        keepJar = !program.get("--jar").empty();
+    std::string jarPath = keepJar ? program.get("--jar") :
+                                    (std::filesystem::temp_directory_path() / "jhunter-hunt-throughput.jar").string();
+
+    Report report;
+    report.addConfig("entries", std::to_string(jarSettings.entries));
+    report.addConfig("entry_size_kib", std::to_string(jarSettings.entrySize / 1024));
+    report.addConfig("pngs_per_mib", formatNumber(jarSettings.pngsPerMiB));
+    report.addConfig("midis_per_mib", formatNumber(jarSettings.midisPerMiB));
+    report.addConfig("stored_ratio", formatNumber(jarSettings.storedRatio));
+    report.addConfig("span_ratio", formatNumber(jarSettings.spanRatio));
+    report.addConfig("seed", std::to_string(jarSettings.seed));
+    report.addConfig("jobs", std::to_string(jobs));
+    report.addConfig("kernel", jhunter::search::getKernelName(jhunter::search::detectKernel()));
+    report.addConfig("crc32_kernel", jhunter::io::getCrc32KernelName());
+
+    bool crc32Matches = checkCrc32();
+    report.add("crc32_matches_zlib", crc32Matches ? 1 : 0);
+
+    bool xxh64Matches = checkXxh64();
+    report.add("xxh64_matches_reference", xxh64Matches ? 1 : 0);
+
+    JarContents contents = generateJar(jarPath, jarSettings);
+    uint64_t    rawBytes = contents.rawBytes;
+
+    std::error_code error;
+    report.add("jar_mib", std::filesystem::file_size(jarPath, error) / (1024.0 * 1024.0));
+    report.add("raw_mib", rawBytes / (1024.0 * 1024.0));
+    report.add("stored_entries", static_cast<double>(contents.storedEntries));
+
+    // Inflate on one thread and on all of them
+    jhunter::io::ZipArchive archive(jarPath);
+    auto [inflateSingle, ignored] = measurePasses(rawBytes, minTime, [&] { return archive.readAllEntries(1).size(); });
+    auto [inflateAll, entries]    = measurePasses(rawBytes, minTime, [&] { return archive.readAllEntries(jobs); });
+    report.add("inflate_mb_s_1_thread", inflateSingle);
+    report.add("inflate_mb_s", inflateAll);
+
+    // The same on a mapped archive, where stored entries are views into the mapping and only deflated ones are
+    // copied out
+    jhunter::io::ArchiveSettings mappedSettings {};
+    mappedSettings.memoryMap = true;
+    jhunter::io::ZipArchive mappedArchive(jarPath, mappedSettings);
+    auto [inflateMapped, mappedEntries] =
+        measurePasses(rawBytes, minTime, [&] { return mappedArchive.readAllEntries(jobs).size(); });
+    report.add("inflate_mapped_mb_s", inflateMapped);
+
+    std::vector<jhunter::hunter::SharedBuffer> buffers = std::move(entries);
+
+    // Every hunter on its own, then both behind the fused scan the CLI uses
+    auto [scanPng, pngCount] =
+        measurePasses(rawBytes, minTime, [&] { return carve<jhunter::hunter::PngHunter>(buffers); });
+    jhunter::hunter::PngHunterSettings verifySettings {};
+    verifySettings.verifyCRC = true;
+    auto [scanPngVerify, pngVerifiedCount] = measurePasses(
+        rawBytes, minTime, [&] { return carve<jhunter::hunter::PngHunter>(buffers, verifySettings); });
+    auto [scanMidi, midiCount] =
+        measurePasses(rawBytes, minTime, [&] { return carve<jhunter::hunter::MidiHunter>(buffers); });
+    auto [scanFused, midiFiles] = measurePasses(rawBytes, minTime, [&] {
+        jhunter::hunter::HunterSet<jhunter::hunter::PngHunter, jhunter::hunter::MidiHunter> hunters;
+        for (const auto& buffer : buffers)
+            hunters.addSourceBuffer(buffer);
+        hunters.get<jhunter::hunter::PngHunter>().parseFiles();
+        return hunters.get<jhunter::hunter::MidiHunter>().parseFiles();
+    });
+    report.add("scan_png_mb_s", scanPng);
+    report.add("scan_png_verify_crc_mb_s", scanPngVerify);
+    report.add("scan_midi_mb_s", scanMidi);
+    report.add("scan_fused_mb_s", scanFused);
+
+    report.add("expected_png", static_cast<double>(contents.pngs));
+    report.add("carved_png", static_cast<double>(pngCount));
+    report.add("carved_png_verified", static_cast<double>(pngVerifiedCount));
+    report.add("expected_midi", static_cast<double>(contents.midis));
+    report.add("carved_midi", static_cast<double>(midiCount));
+    report.add("spanning_assets", static_cast<double>(contents.spanning));
+
+    // Render the first MIDIs on all threads. Audio seconds rendered per second of wall time, above 1 is faster
+    // than real time. Measured with the default format and with a cheap preview format
+    if (renders > 0 && !midiFiles.empty())
+    {
+        midiFiles.resize(std::min(renders, midiFiles.size()));
+
+        // Returns the audio seconds rendered and the wall time it took, nothing when the SoundFont is missing
+        auto measureRenders = [&](const jhunter::hunter::SynthSettings& synth, int channels)
+            -> std::optional<std::pair<double, double>> {
+            jhunter::hunter::MidiHunterSettings midiSettings {};
+            midiSettings.renderThreads = jobs;
+            midiSettings.sink          = std::make_shared<NullSink>();
+            midiSettings.synth         = synth;
+            midiSettings.channels      = channels;
+            try
+            {
+                midiSettings.synthPool = std::make_shared<jhunter::hunter::SynthPool>(
+                    (workingDir / "assets/default.sf2").generic_string(), jobs, synth);
+            }
+            catch (const std::runtime_error&)
+            {
+                return std::nullopt; // Already reported
+            }
+
+            jhunter::hunter::MidiHunter midiHunter;
+            midiSettings.quiet = true; // Console output is not what is measured here
+            midiHunter.setSettings(midiSettings);
+
+            auto start = Clock::now();
+            midiHunter.saveFiles(midiFiles, "bench", "audio_");
+            std::chrono::duration<double> elapsed = Clock::now() - start;
+
+            auto&    sink       = static_cast<NullSink&>(*midiSettings.sink);
+            uint64_t wavHeaders = midiFiles.size() * 44;
+            uint64_t bytes      = std::max<uint64_t>(sink.getWavBytes(), wavHeaders) - wavHeaders;
+            double   frameSize  = static_cast<double>(channels) * midiSettings.bitsPerSample / 8;
+            return std::make_pair(static_cast<double>(bytes) / (synth.sampleRate * frameSize), elapsed.count());
+        };
+
+        auto full = measureRenders(jhunter::hunter::SynthSettings {}, 2);
+        if (full)
+        {
+            report.add("wav_audio_seconds", full->first);
+            report.add("wav_realtime_factor", full->first / full->second);
+
+            // Each release swaps the synth for a fresh one to keep renders byte-identical, time that swap alone and
+            // as a share of the render threads' time above
+            jhunter::hunter::SynthPool pool((workingDir / "assets/default.sf2").generic_string(), 1);
+            constexpr int              cycles = 16;
+            auto                       start  = Clock::now();
+            for (int i = 0; i < cycles; ++i)
+                pool.release(pool.acquire());
+            std::chrono::duration<double> recycle = (Clock::now() - start) / cycles;
+            report.add("synth_recycle_ms", recycle.count() * 1000);
+            report.add("synth_recycle_share", recycle.count() * midiFiles.size() / (full->second * jobs));
+
+            jhunter::hunter::SynthSettings preview {};
+            preview.sampleRate    = 22050;
+            preview.polyphony     = 64;
+            preview.interpolation = FLUID_INTERP_LINEAR;
+            if (auto previewed = measureRenders(preview, 1))
+                report.add("wav_preview_realtime_factor", previewed->first / previewed->second);
+        }
+    }
+
+    if (!keepJar)
+        std::filesystem::remove(jarPath, error);
+
+    std::string jsonPath = program.get("--json");
+    if (jsonPath != "-")
+        report.print();
+
+    bool carvedAll = pngCount == contents.pngs && pngVerifiedCount == contents.pngs && midiCount == contents.midis;
+    if (!carvedAll)
+        std::fprintf(stderr, "MISMATCH: carved assets differ from the generated ones\n");
+
+    if (jsonPath == "-")
+    {
+        report.writeJson(stdout);
+    }
+    else if (!jsonPath.empty())
+    {
+        std::FILE* out = std::fopen(jsonPath.c_str(), "w");
+        if (!out)
+        {
+            std::cerr << "Error: Failed to open file for writing: " << jsonPath << std::endl;
+            return 1;
+        }
+        report.writeJson(out);
+        std::fclose(out);
+    }
+
+    return carvedAll && crc32Matches && xxh64Matches ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include "j2me-asset-hunter/lib.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+    using Corpus = std::vector<jhunter::io::Buffer>;
+
+    // The implementation findSequenceInBuffer used before the search kernel, kept as the baseline
+    size_t findWithStdSearch(const jhunter::io::Buffer& buffer, const std::string& seq, size_t startPos)
+    {
+        auto it = std::search(buffer.begin() + startPos, buffer.end(), seq.begin(), seq.end());
+        return it != buffer.end() ? std::distance(buffer.begin(), it) : std::string::npos;
+    }
+
+    // Run a search function over the whole corpus and count every match, like a hunter would
+    template<typename FindFunc>
+    size_t countMatches(const Corpus& corpus, FindFunc&& find)
+    {
+        size_t matches = 0;
+        for (const auto& buffer : corpus)
+        {
+            size_t pos = 0;
+            while (pos < buffer.size())
+            {
+                size_t found = find(buffer, pos);
+                if (found == std::string::npos)
+                    break;
+                ++matches;
+                pos = found + 1;
+            }
+        }
+        return matches;
+    }
+
+    // Repeat a full pass over the corpus until enough time has elapsed, returns MB/s and the match count of one pass
+    template<typename PassFunc>
+    std::pair<double, size_t> measurePasses(size_t corpusBytes, PassFunc&& pass)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        size_t matches    = pass(); // Warm-up
+        size_t iterations = 0;
+        auto   start      = Clock::now();
+        auto   elapsed    = std::chrono::duration<double>(0);
+        while (elapsed.count() < 0.5)
+        {
+            matches = pass();
+            ++iterations;
+            elapsed = Clock::now() - start;
+        }
+
+        double megabytes = static_cast<double>(corpusBytes) * iterations / (1024.0 * 1024.0);
+        return {megabytes / elapsed.count(), matches};
+    }
+
+    template<typename FindFunc>
+    std::pair<double, size_t> measure(const Corpus& corpus, size_t corpusBytes, FindFunc&& find)
+    {
+        return measurePasses(corpusBytes, [&] { return countMatches(corpus, find); });
+    }
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string jarPath = argc > 1 ? argv[1] : "assets/test.jar";
+    int         repeat  = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+
+    jhunter::io::ZipArchive archive(jarPath);
+
+    Corpus corpus;
+    size_t corpusBytes = 0;
+    for (const auto& entry : archive.listEntries())
+    {
+        corpus.emplace_back(archive.readFile(entry));
+        corpusBytes += corpus.back().size();
+    }
+
+    // With a repeat count, scan one large buffer instead so the data no longer fits in cache
+    if (repeat > 1)
+    {
+        jhunter::io::Buffer large;
+        large.reserve(corpusBytes * repeat);
+        for (int r = 0; r < repeat; ++r)
+        {
+            for (const auto& buffer : corpus)
+                large.insert(large.end(), buffer.begin(), buffer.end());
+        }
+        corpus.assign(1, std::move(large));
+        corpusBytes = corpus.front().size();
+    }
+
+    std::printf("corpus: %s x%d, %zu buffers, %zu bytes\n", jarPath.c_str(), repeat, corpus.size(), corpusBytes);
+    std::printf("best kernel: %s\n\n", jhunter::search::getKernelName(jhunter::search::detectKernel()));
+
+    const std::vector<std::pair<const char*, std::string>> needles = {
+        {"png-signature", std::string("\x89PNG\r\n\x1A\n", 8)},
+        {"png-iend", std::string("\x49\x45\x4E\x44\xAE\x42\x60\x82", 8)},
+        {"midi-mthd", std::string("MThd", 4)},
+    };
+
+    const jhunter::search::Kernel kernels[] = {
+        jhunter::search::Kernel::Scalar,
+        jhunter::search::Kernel::SSE2,
+        jhunter::search::Kernel::AVX2,
+    };
+
+    std::printf("%-14s %-10s %12s %10s %8s\n", "needle", "kernel", "MB/s", "speedup", "matches");
+    for (const auto& [name, bytes] : needles)
+    {
+        auto [baseline, baselineMatches] = measure(corpus, corpusBytes, [&](const jhunter::io::Buffer& buffer, size_t pos) {
+            return findWithStdSearch(buffer, bytes, pos);
+        });
+        std::printf("%-14s %-10s %12.1f %9.2fx %8zu\n", name, "std-search", baseline, 1.0, baselineMatches);
+
+        jhunter::search::BytePattern pattern(bytes);
+        for (auto kernel : kernels)
+        {
+            if (!jhunter::search::isKernelSupported(kernel))
+                continue;
+
+            pattern.setKernel(kernel);
+            auto [throughput, matches] = measure(corpus, corpusBytes, [&](const jhunter::io::Buffer& buffer, size_t pos) {
+                return pattern.find(buffer.data(), buffer.size(), pos);
+            });
+            std::printf("%-14s %-10s %12.1f %9.2fx %8zu%s\n",
+                        name,
+                        jhunter::search::getKernelName(kernel),
+                        throughput,
+                        throughput / baseline,
+                        matches,
+                        matches == baselineMatches ? "" : "  MISMATCH");
+        }
+    }
+
+    // Fused scan: one automaton pass for all signatures versus one kernel pass per signature,
+    // with extra signatures added to show how the cost grows with the number of formats
+    std::vector<std::pair<const char*, std::string>> formats = needles;
+    formats.push_back({"wav-riff", "RIFF"});
+    formats.push_back({"ogg-page", "OggS"});
+
+    std::vector<std::unique_ptr<jhunter::search::BytePattern>> patterns;
+    for (const auto& format : formats)
+        patterns.emplace_back(std::make_unique<jhunter::search::BytePattern>(format.second));
+
+    std::printf("\n%-9s %14s %14s %10s %8s\n", "formats", "separate MB/s", "fused MB/s", "speedup", "matches");
+    for (size_t count = 1; count <= patterns.size(); ++count)
+    {
+        auto [separate, separateMatches] = measurePasses(corpusBytes, [&] {
+            size_t matches = 0;
+            for (size_t k = 0; k < count; ++k)
+            {
+                matches += countMatches(corpus, [&](const jhunter::io::Buffer& buffer, size_t pos) {
+                    return patterns[k]->find(buffer.data(), buffer.size(), pos);
+                });
+            }
+            return matches;
+        });
+
+        jhunter::search::MultiPattern automaton;
+        for (size_t k = 0; k < count; ++k)
+            automaton.addPattern(patterns[k].get());
+        automaton.compile();
+
+        auto [fused, fusedMatches] = measurePasses(corpusBytes, [&] {
+            size_t matches = 0;
+            for (const auto& buffer : corpus)
+            {
+                auto table = automaton.scan(buffer.data(), buffer.size());
+                for (size_t k = 0; k < count; ++k)
+                {
+                    for (size_t at = table.find(*patterns[k], 0); at != std::string::npos;
+                         at        = table.find(*patterns[k], at + 1))
+                        ++matches;
+                }
+            }
+            return matches;
+        });
+
+        std::printf("%-9zu %14.1f %14.1f %9.2fx %8zu%s\n",
+                    count,
+                    separate,
+                    fused,
+                    fused / separate,
+                    fusedMatches,
+                    fusedMatches == separateMatches ? "" : "  MISMATCH");
+    }
+
+    return 0;
+}
@@ -0,0 +1,2 @@
+includes("search-kernel")
+includes("hunt-throughput")
@@ -14,7 +14,8 @@ int main()
     auto entries = archive.listEntries();
     for (const auto& entry : entries)
     {
-        auto buffer = archive.readFile(entry);
+        // Both hunters reference the same buffer instead of each keeping a copy
+        auto buffer = jhunter::hunter::makeSharedBuffer(archive.readFile(entry));
         pngHunter.addSourceBuffer(buffer);
         midiHunter.addSourceBuffer(buffer);
     }
@@ -0,0 +1,26 @@
+#include "j2me-asset-hunter/lib.hpp"
+
+#include <iostream>
+
+int main()
+{
+    jhunter::hunter::HuntSettings settings {};
+    settings.stream.inflateThreads = 4;
+
+    // Assets come out while the rest of the jar is still being inflated and hunted
+    jhunter::hunter::AssetStream stream("assets/test.jar", settings);
+
+    size_t pngCount = 0;
+    while (auto asset = stream.next())
+    {
+        const char* type = asset->type == jhunter::hunter::AssetType::PNG ? "PNG" : "MIDI";
+        std::cout << type << " of " << asset->data.size() << " bytes at " << asset->source.entryName << "+"
+                  << asset->source.offset << std::endl;
+
+        // Stop early once we have what we came for, the rest of the jar is never inflated
+        if (asset->type == jhunter::hunter::AssetType::PNG && ++pngCount == 3)
+            break;
+    }
+
+    return 0;
+}
@@ -1 +1,2 @@
-includes("library-usage")
\ No newline at end of file
+includes("library-usage")
+includes("streaming-api")
\ No newline at end of file
@@ -1,15 +1,305 @@
 #pragma once
 
 #include <argparse/argparse.hpp>
+#include <fluidsynth.h>
 #include <zip.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace jhunter
 {
     namespace cli
-    {}
+    {
+        // Expand the jar inputs of a batch into jar paths. An input is a jar, a directory searched recursively for
+        // jars, or a glob with * and ? in its last path component. Each non-empty line of listFile that does not
+        // start with # is one more input. Duplicates are dropped, the order is kept
+        std::vector<std::filesystem::path> collectInputs(const std::vector<std::string>& inputs,
+                                                         const std::string&              listFile = "");
+
+        // Whether an input names more than one jar, i.e. is a directory or a glob
+        bool isMultiInput(const std::string& input);
+
+        // A value of a flat JSON object. Strings are unescaped, numbers, true, false and null kept as written
+        struct JsonValue
+        {
+            std::string text;
+            bool        quoted = false; // Whether it was a string
+
+            // The value as JSON again
+            std::string toJson() const;
+        };
+
+        // Parse a JSON object whose values are all strings, numbers, true, false or null, as sent to --serve.
+        // Throws std::runtime_error on anything else
+        std::map<std::string, JsonValue> parseJsonObject(std::string_view text);
+
+        // text as a JSON string, quotes included
+        std::string quoteJson(std::string_view text);
+
+        // Writes one line back to the client a request came from. May be called from any thread, also after the
+        // handler returned, as long as the server runs
+        using Reply = std::function<void(const std::string& line)>;
+
+        // Called with every line a client sends, on the thread reading that client
+        using LineHandler = std::function<void(const std::string& line, const Reply& reply)>;
+
+        // Serve newline-delimited requests from stdin, replying on stdout, until stdin ends
+        void serveStdin(const LineHandler& onLine);
+
+        // Serve newline-delimited requests on a Unix domain socket, every client on a thread of its own, until
+        // stopping is set. A socket file left by an earlier server is replaced, the file is removed when done
+        void serveSocket(const std::string& socketPath, const LineHandler& onLine, const std::atomic<bool>& stopping);
+    } // namespace cli
+
+    namespace stats
+    {
+        // What the library counts while hunting. Times are summed over all threads
+        enum class Counter : size_t
+        {
+            EntriesInflated,
+            BytesInflated,
+            InflateNanos,
+            EntriesMapped, // STORED entries hunted in place in a memory-mapped jar, not inflated
+            BytesMapped,
+            EntriesSkipped, // Left out by an io::EntryFilter without being read
+            BytesSkipped,
+            BytesScanned, // By the fused signature scan of a HunterSet
+            ScanNanos,
+            BytesParsed, // By each hunter walking its buffers, including its own signature search
+            ParseNanos,
+            SignatureMatches, // Asset headers a hunter looked at
+            RejectedCandidates,
+            PngsCarved,
+            MidisCarved,
+            BytesCopied, // Carved assets flattened into a buffer of their own
+            FilesWritten,
+            BytesWritten,
+            WriteNanos,
+            WavsRendered,
+            RenderNanos,
+            AudioNanos,
+            WavsCutByDuration, // Renders cut short by a limit of MidiHunterSettings
+            WavsCutByTime,
+            WavsCutBySilence,
+            EmbeddedStreams, // Compressed streams found inside entries and inflated
+            BytesEmbedded,
+            EmbeddedNanos, // Searching and inflating them, false candidates included
+            ArenaBytes,    // Taken from the heap by the arenas of all jars, summed
+            ArenaJarPeak,  // The most a single jar's arena took
+            ArenaPeak,     // The most all arenas alive at once took together
+            Count
+        };
+
+        // Add to a counter of this process. Relaxed and on a cache line of its own, so calls from many threads stay
+        // cheap. The library still only counts per entry, buffer, asset or file
+        void add(Counter counter, uint64_t value);
+
+        // Raise a counter to value if it is lower, for high-water marks
+        void raise(Counter counter, uint64_t value);
+
+        // Adds the time from construction to destruction to a nanosecond counter
+        class ScopedTimer
+        {
+        public:
+            explicit ScopedTimer(Counter counter) : m_Counter(counter), m_Start(std::chrono::steady_clock::now()) {}
+            ~ScopedTimer();
+
+            ScopedTimer(const ScopedTimer&)            = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        private:
+            Counter                               m_Counter;
+            std::chrono::steady_clock::time_point m_Start;
+        };
+
+        // A snapshot of all counters
+        struct Stats
+        {
+            uint64_t entriesInflated    = 0;
+            uint64_t bytesInflated      = 0;
+            double   inflateSeconds     = 0;
+            uint64_t entriesMapped      = 0;
+            uint64_t bytesMapped        = 0;
+            uint64_t entriesSkipped     = 0;
+            uint64_t bytesSkipped       = 0;
+            uint64_t bytesScanned       = 0;
+            double   scanSeconds        = 0;
+            uint64_t bytesParsed        = 0;
+            double   parseSeconds       = 0;
+            uint64_t signatureMatches   = 0;
+            uint64_t rejectedCandidates = 0;
+            uint64_t pngsCarved         = 0;
+            uint64_t midisCarved        = 0;
+            uint64_t bytesCopied        = 0;
+            uint64_t filesWritten       = 0;
+            uint64_t bytesWritten       = 0;
+            double   writeSeconds       = 0;
+            uint64_t wavsRendered       = 0;
+            double   renderSeconds      = 0;
+            double   audioSeconds       = 0;
+            uint64_t wavsCutByDuration  = 0;
+            uint64_t wavsCutByTime      = 0;
+            uint64_t wavsCutBySilence   = 0;
+            uint64_t embeddedStreams    = 0;
+            uint64_t bytesEmbedded      = 0;
+            double   embeddedSeconds    = 0;
+            uint64_t arenaBytes         = 0;
+            uint64_t arenaJarPeak       = 0;
+            uint64_t arenaPeak          = 0;
+
+            // One JSON object with a member per field, named like the fields
+            std::string toJson() const;
+        };
+
+        Stats getStats();
+        void  resetStats();
+    } // namespace stats
+
+    namespace memory
+    {
+        // The working memory of one jar: its entry buffers, entry names and embedded streams. Allocations only bump
+        // a pointer and are never freed one by one, everything goes back to the upstream resource in one go when the
+        // arena is destroyed. Unlike std::pmr::monotonic_buffer_resource it may be used from several threads
+        class Arena : public std::pmr::memory_resource
+        {
+        public:
+            explicit Arena(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+            // Reports the bytes taken to stats::Counter::ArenaBytes and friends
+            ~Arena() override;
+
+            Arena(const Arena&)            = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            // Bytes taken from upstream so far. Nothing is given back before destruction, so this is also the
+            // high-water mark of the jar, the number to size a worker by
+            size_t getHighWaterMark() const { return m_Taken.load(std::memory_order_relaxed); }
+
+        protected:
+            void* do_allocate(size_t bytes, size_t alignment) override;
+            void  do_deallocate(void* p, size_t bytes, size_t alignment) override;
+            bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        private:
+            // Sits between the monotonic resource and upstream to count the blocks it takes
+            class Counting : public std::pmr::memory_resource
+            {
+            public:
+                Counting(std::pmr::memory_resource* upstream, std::atomic<size_t>& taken) :
+                    m_Upstream(upstream), m_Taken(taken)
+                {}
+
+            protected:
+                void* do_allocate(size_t bytes, size_t alignment) override;
+                void  do_deallocate(void* p, size_t bytes, size_t alignment) override;
+                bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+                {
+                    return this == &other;
+                }
+
+            private:
+                std::pmr::memory_resource* m_Upstream;
+                std::atomic<size_t>&       m_Taken;
+            };
+
+            std::atomic<size_t>                 m_Taken {0};
+            Counting                            m_Counting;
+            std::mutex                          m_Mutex;
+            std::pmr::monotonic_buffer_resource m_Monotonic;
+        };
+    } // namespace memory
 
     namespace io
     {
+        // CRC-32 as used by zip and PNG, call with crc = 0 to start a new checksum. Runs on the fastest
+        // implementation of the CPU: PCLMULQDQ folding on x86, the CRC32 instructions on ARMv8, slice-by-8 tables
+        // otherwise (evaluated once)
+        uint32_t crc32(uint32_t crc, const void* data, size_t size);
+
+        // Get a printable name of the CRC-32 implementation in use
+        const char* getCrc32KernelName();
+
+        // An inflated entry or stream. Allocated from the resource passed to the function creating it, by default
+        // from the heap like any vector
+        using Buffer = std::pmr::vector<char>;
+
+        // Bytes to hunt in, an inflated Buffer or a range of a memory-mapped archive
+        using ByteSpan = std::span<const char>;
+
+        // Shared bytes that stay valid as long as the pointer lives, whatever owns them
+        using SharedBytes = std::shared_ptr<const ByteSpan>;
+
+        // A file mapped read-only into memory
+        class MappedFile
+        {
+        public:
+            explicit MappedFile(const std::string& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&)            = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const { return m_Data; }
+            size_t      size() const { return m_Size; }
+
+        private:
+            const char* m_Data = nullptr;
+            size_t      m_Size = 0;
+        };
+
+        // Decides from the central directory alone which entries can not hold an asset, so they are never inflated
+        struct EntryFilter
+        {
+            // Entries whose whole name matches one of these, * matching any run of characters and ? a single one
+            std::vector<std::string> skipNames = {"*.class", "META-INF/*"};
+
+            // Entries smaller than this are skipped. 0 keeps them all, an asset may start in one entry and end in
+            // the next
+            uint64_t minSize = 0;
+
+            // Entries larger than this are skipped, 0 for no limit
+            uint64_t maxSize = 0;
+
+            // Skip entries libzip can not decompress anyway, like encrypted ones
+            bool skipUnreadable = true;
+        };
+
+        struct ArchiveSettings
+        {
+            // Map the archive into memory. STORED entries are then hunted in place instead of copied out
+            bool memoryMap = false;
+
+            // Check mapped STORED entries against the CRC-32 of the central directory, like libzip does when it reads
+            // an entry
+            bool verifyMappedCRC = true;
+
+            // A skipped entry reads as empty, so entry indices stay the same
+            std::optional<EntryFilter> filter;
+        };
+
         struct ZipDeleter
         {
             void operator()(zip_t* z) const
@@ -31,26 +321,574 @@ namespace jhunter
         class ZipArchive
         {
         public:
-            ZipArchive(const std::string& zipPath);
+            explicit ZipArchive(const std::string& zipPath, const ArchiveSettings& settings = {});
+
+            const std::string& getPath() const { return m_ZipPath; }
+
+            // Entry names, allocated from resource
+            std::pmr::vector<std::pmr::string>
+                   listEntries(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+            Buffer readFile(std::string_view           fileName,
+                            std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+            // Number of entries in the central directory, valid indices are [0, getNumEntries())
+            size_t            getNumEntries() const;
+            std::string       getEntryName(size_t index) const;
+
+            // Hash of the central directory: name, CRC-32, sizes and compression method of every entry. Stays the
+            // same as long as no entry changes, and is computed without decompressing anything
+            uint64_t getFingerprint() const;
+            Buffer   readEntry(size_t                     index,
+                               std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
 
-            std::vector<std::string> listEntries() const;
-            std::vector<char>        readFile(const std::string& fileName) const;
+            // Check an entry read by readEntry against the size and CRC-32 of the central directory
+            bool verifyEntry(size_t index, ByteSpan buffer) const;
+
+            // Whether the entry filter leaves an entry out
+            bool isSkipped(size_t index) const { return index < m_Skipped.size() && m_Skipped[index]; }
+
+            // Whether the archive is memory-mapped, see ArchiveSettings
+            bool isMapped() const { return m_Mapping != nullptr; }
+
+            // The functions below honor the settings: skipped entries are empty and STORED entries of a mapped archive
+            // are views into the mapping. Inflated entries are allocated from owner (the heap if null), which they
+            // keep alive, so with a memory::Arena all of them are released at once when the jar is done
+
+            // Decompress all entries on threadCount workers, each with its own libzip handle.
+            // Results are in entry index order no matter which worker finished first
+            std::vector<SharedBytes> readAllEntries(size_t                                     threadCount,
+                                                    std::shared_ptr<std::pmr::memory_resource> owner = nullptr) const;
+
+            // Decompress entries [first, first + count) with a libzip handle of its own, so calls may run on
+            // several threads at once
+            std::vector<SharedBytes> readEntries(size_t                                     first,
+                                                 size_t                                     count,
+                                                 std::shared_ptr<std::pmr::memory_resource> owner = nullptr) const;
+
+            // Called with each entry, return false to stop reading
+            using EntryCallback = std::function<bool(size_t index, SharedBytes buffer)>;
+
+            // Decompress entries on threadCount workers and hand each one to onEntry as soon as it and all entries
+            // before it are ready. Calls are serialized and in index order, a blocking callback throttles the workers.
+            // Entries inflated ahead of their turn take at most memoryLimit bytes together (0 for no limit), counted
+            // by their sizes in the central directory before they are inflated
+            void streamEntries(size_t threadCount, const EntryCallback& onEntry, size_t memoryLimit = 0) const;
 
         private:
+            struct Mapping;
+
+            SharedBytes readShared(zip_t*                                            handle,
+                                   size_t                                            index,
+                                   const std::shared_ptr<std::pmr::memory_resource>& owner) const;
+
+            std::string                        m_ZipPath;
             std::unique_ptr<zip_t, ZipDeleter> m_ZipHandle;
+            ArchiveSettings                    m_Settings;
+            std::shared_ptr<const Mapping>     m_Mapping; // Set when mapped, shared with the views handed out
+            std::vector<bool>                  m_Skipped; // Per entry, empty without a filter
         };
+
+        // Limits for inflating compressed streams found inside an entry, like the zlib sections of packed sprite
+        // blobs. Budgets are per entry and cover all depths, so a hostile entry can not blow up the run
+        struct EmbeddedStreamSettings
+        {
+            // Streams inside inflated streams are followed this many levels deep, 1 inflates only what is in
+            // the entry itself
+            size_t maxDepth = 2;
+
+            // Total inflated bytes kept per entry
+            size_t maxOutputBytes = 64 * 1024 * 1024;
+
+            // Time spent searching and inflating per entry
+            std::chrono::milliseconds timeBudget {250};
+
+            // Streams inflating to fewer bytes are dropped, they can not hold an asset worth hunting
+            size_t minOutputSize = 64;
+
+            // Also try headerless deflate streams. They can start at almost any byte, so this is far slower than
+            // looking for zlib and gzip headers and mostly relies on the time budget
+            bool rawDeflate = false;
+        };
+
+        // Find complete zlib, gzip (and optionally raw deflate) streams in buffer and inflate them, followed by the
+        // streams inside their output up to maxDepth. zlib and gzip streams must pass their checksum. The image
+        // data of PNGs is skipped. Results are in the order the streams were found, each nested stream right after
+        // its container. The streams are allocated from resource
+        std::vector<Buffer>
+        inflateEmbeddedStreams(ByteSpan                      buffer,
+                               const EmbeddedStreamSettings& settings,
+                               std::pmr::memory_resource*    resource = std::pmr::get_default_resource());
     } // namespace io
 
+    namespace search
+    {
+        // Instruction set used by the signature search kernel
+        enum class Kernel
+        {
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        // Detect the best kernel supported by the running CPU (evaluated once)
+        Kernel detectKernel();
+
+        // Check if a kernel can run on this CPU
+        bool isKernelSupported(Kernel kernel);
+
+        // Get a printable name of a kernel
+        const char* getKernelName(Kernel kernel);
+
+        // A byte sequence precompiled once for repeated searching
+        class BytePattern
+        {
+        public:
+            static constexpr size_t npos = std::string::npos;
+
+            explicit BytePattern(std::string_view bytes);
+
+            // Find the pattern in [data, data + size) starting at startPos, returns npos if not found
+            size_t find(const char* data, size_t size, size_t startPos = 0) const;
+
+            // Force a specific kernel, mainly for benchmarking
+            void setKernel(Kernel kernel);
+
+            Kernel             getKernel() const { return m_Kernel; }
+            const std::string& bytes() const { return m_Bytes; }
+            size_t             size() const { return m_Bytes.size(); }
+
+        private:
+            std::string m_Bytes;
+            Kernel      m_Kernel;
+        };
+
+        // Positions of every pattern occurrence found by one pass over a buffer
+        class MatchTable
+        {
+        public:
+            // Record an occurrence, positions of one pattern must be added in increasing order
+            void add(const BytePattern* pattern, size_t position);
+
+            // Register a pattern that was part of the scan, even if it never matched
+            void addPattern(const BytePattern* pattern);
+
+            // Check if the pattern was part of the scan that produced this table
+            bool contains(const BytePattern& pattern) const;
+
+            // Find the first occurrence at or after startPos, returns npos if there is none
+            size_t find(const BytePattern& pattern, size_t startPos) const;
+
+            // Keep only the given patterns
+            MatchTable select(const std::vector<const BytePattern*>& patterns) const;
+
+        private:
+            struct Entry
+            {
+                const BytePattern*  pattern;
+                std::vector<size_t> positions;
+            };
+
+            const Entry* findEntry(const BytePattern* pattern) const;
+
+            std::vector<Entry> m_Entries;
+        };
+
+        // Aho-Corasick automaton over several byte patterns, finds all of them in one pass
+        class MultiPattern
+        {
+        public:
+            // Add a pattern, it must outlive the automaton. Adding the same pattern twice is a no-op
+            void addPattern(const BytePattern* pattern);
+
+            // Build the automaton, must be called after the last addPattern and before scan
+            void compile();
+
+            // Scan a buffer once and collect every occurrence of every pattern
+            MatchTable scan(const char* data, size_t size) const;
+
+            const std::vector<const BytePattern*>& getPatterns() const { return m_Patterns; }
+
+        private:
+            void addCandidateFilter(char firstByte, char lastByte, size_t lastOffset);
+
+            // Skip to the next position where the first and last byte of some pattern match
+            size_t skipToCandidate(const char* data, size_t size, size_t pos) const;
+
+            std::vector<const BytePattern*> m_Patterns;
+            std::vector<uint32_t>           m_Transitions;   // Dense DFA, 256 entries per state
+            std::vector<uint32_t>           m_OutputOffsets; // Per state range into m_Outputs
+            std::vector<uint32_t>           m_Outputs;       // Pattern ids matched when entering a state
+            std::string                     m_FirstBytes;    // Candidate filter, one entry per distinct pattern
+            std::string                     m_LastBytes;
+            std::vector<size_t>             m_LastOffsets;
+            bool                            m_Compiled = false;
+        };
+    } // namespace search
+
+    namespace pipeline
+    {
+        // Settings of the streaming mode
+        struct StreamSettings
+        {
+            // Approximate cap on bytes waiting between stages. Half goes to the carved assets waiting to be written,
+            // the other half to inflated entries: those being inflated ahead of their turn and those waiting to be
+            // scanned get a quarter each
+            size_t memoryLimit = 256 * 1024 * 1024;
+
+            // Number of threads inflating entries
+            size_t inflateThreads = 1;
+
+            // Also hunt compressed streams embedded in the entries, see io::inflateEmbeddedStreams
+            std::optional<io::EmbeddedStreamSettings> embedded;
+        };
+
+        // A FIFO queue bounded by the total weight (usually bytes) of its items, used to connect pipeline stages
+        template<typename T>
+        class BoundedQueue
+        {
+        public:
+            explicit BoundedQueue(size_t capacity) : m_Capacity(capacity) {}
+
+            // Block until the item fits. An item heavier than the whole capacity is let in once the queue is empty,
+            // so it can not block forever. Returns false if the queue was closed
+            bool push(T item, size_t weight)
+            {
+                std::unique_lock lock(m_Mutex);
+                m_NotFull.wait(lock, [&] { return m_Closed || m_Items.empty() || m_Weight + weight <= m_Capacity; });
+                if (m_Closed)
+                    return false;
+
+                m_Items.emplace_back(std::move(item), weight);
+                m_Weight += weight;
+                m_NotEmpty.notify_one();
+                return true;
+            }
+
+            // Block until an item is available, returns nullopt once the queue is closed and drained
+            std::optional<T> pop()
+            {
+                std::unique_lock lock(m_Mutex);
+                m_NotEmpty.wait(lock, [&] { return m_Closed || !m_Items.empty(); });
+                if (m_Items.empty())
+                    return std::nullopt;
+
+                auto [item, weight] = std::move(m_Items.front());
+                m_Items.pop_front();
+                m_Weight -= weight;
+                m_NotFull.notify_all();
+                return std::move(item);
+            }
+
+            // No more items will be pushed, pending items can still be popped
+            void close()
+            {
+                std::lock_guard lock(m_Mutex);
+                m_Closed = true;
+                m_NotEmpty.notify_all();
+                m_NotFull.notify_all();
+            }
+
+            // Drop pending items and close, used to abort a pipeline
+            void cancel()
+            {
+                std::lock_guard lock(m_Mutex);
+                m_Items.clear();
+                m_Weight = 0;
+                m_Closed = true;
+                m_NotEmpty.notify_all();
+                m_NotFull.notify_all();
+            }
+
+        private:
+            std::mutex                       m_Mutex;
+            std::condition_variable          m_NotEmpty;
+            std::condition_variable          m_NotFull;
+            std::deque<std::pair<T, size_t>> m_Items;
+            size_t                           m_Capacity;
+            size_t                           m_Weight = 0;
+            bool                             m_Closed = false;
+        };
+
+        // A work-stealing thread pool. A task submitted by a worker goes to the front of that worker's deque and is
+        // taken newest first, so a job's follow-up work runs while its data is hot and few jobs are in flight.
+        // Idle workers steal the oldest task of another worker, which balances big and small jobs across cores
+        class TaskPool
+        {
+        public:
+            using Task = std::function<void()>;
+
+            explicit TaskPool(size_t threadCount);
+            ~TaskPool();
+
+            TaskPool(const TaskPool&)            = delete;
+            TaskPool& operator=(const TaskPool&) = delete;
+
+            // Thread-safe, tasks may submit more tasks
+            void submit(Task task);
+
+            // Block until every task, including the ones submitted by tasks, has run. Rethrows the first exception
+            // a task let through, the other tasks still run. Must not be called from a task
+            void wait();
+
+            size_t size() const { return m_Workers.size(); }
+
+        private:
+            struct Worker
+            {
+                std::mutex       mutex;
+                std::deque<Task> tasks;
+            };
+
+            void workerLoop(size_t index);
+            bool takeTask(size_t index, Task& task);
+
+        private:
+            std::vector<std::unique_ptr<Worker>> m_Workers;
+            std::vector<std::thread>             m_Threads;
+
+            std::mutex              m_Mutex;
+            std::condition_variable m_TaskAdded;
+            std::condition_variable m_AllDone;
+            size_t                  m_Queued     = 0; // Tasks submitted but not taken yet
+            size_t                  m_Unfinished = 0; // Tasks submitted but not finished yet
+            size_t                  m_NextWorker = 0; // Deque that gets the next task submitted from outside
+            bool                    m_Stopping   = false;
+            std::exception_ptr      m_Error;
+        };
+    } // namespace pipeline
+
     namespace hunter
     {
+        // An immutable source buffer, shared by every hunter and carved asset that references it
+        using SharedBuffer = io::SharedBytes;
+
+        // Wrap a buffer for sharing, moves instead of copying when given an rvalue
+        inline SharedBuffer makeSharedBuffer(io::Buffer buffer)
+        {
+            struct Owned
+            {
+                io::Buffer   buffer;
+                io::ByteSpan bytes;
+            };
+
+            auto owned   = std::make_shared<Owned>(Owned {std::move(buffer), {}});
+            owned->bytes = owned->buffer;
+            return SharedBuffer(owned, &owned->bytes);
+        }
+
+        // Wrap a buffer allocated from owner, usually a memory::Arena, which stays alive as long as the buffer
+        // or any asset carved from it
+        inline SharedBuffer makeSharedBuffer(io::Buffer buffer, std::shared_ptr<std::pmr::memory_resource> owner)
+        {
+            struct Owned
+            {
+                std::shared_ptr<std::pmr::memory_resource> owner; // Declared first, so destroyed after the buffer
+                io::Buffer                                 buffer;
+                io::ByteSpan                               bytes;
+            };
+
+            auto owned   = std::make_shared<Owned>(Owned {std::move(owner), std::move(buffer), {}});
+            owned->bytes = owned->buffer;
+            return SharedBuffer(owned, &owned->bytes);
+        }
+
+        // A byte range of a shared source buffer
+        struct ByteView
+        {
+            SharedBuffer buffer;
+            size_t       offset = 0;
+            size_t       size   = 0;
+
+            const char* data() const { return buffer->data() + offset; }
+        };
+
+        // Bytes of a carved asset, kept as views into the source buffers. An asset spanning several buffers
+        // has one segment per buffer. Bytes are only copied by toVector() or when written out
+        class CarvedData
+        {
+        public:
+            // Append a range of a buffer, merged into the last segment when contiguous
+            void append(const SharedBuffer& buffer, size_t offset, size_t size);
+
+            void clear();
+
+            bool   empty() const { return m_Size == 0; }
+            size_t size() const { return m_Size; }
+
+            const std::vector<ByteView>& getSegments() const { return m_Segments; }
+
+            // Copy the bytes into an owned buffer
+            std::vector<char> toVector() const;
+
+            // Write the bytes to a stream segment by segment
+            void writeTo(std::ostream& stream) const;
+
+            // 64-bit XXH64 hash of the bytes, the same no matter how they are split into segments
+            uint64_t contentHash() const;
+
+        private:
+            std::vector<ByteView> m_Segments;
+            size_t                m_Size = 0;
+        };
+
+        // Where saved assets go. Paths are what a plain file would be (output directory / file name), the sink
+        // decides how they are stored. An asynchronous sink writes on a background thread, so hunting only waits when
+        // memoryLimit bytes are queued. The writer drains everything queued in one go. Thread-safe
+        class OutputSink
+        {
+        public:
+            static constexpr size_t DEFAULT_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+            explicit OutputSink(bool async = true, size_t memoryLimit = DEFAULT_MEMORY_LIMIT);
+            virtual ~OutputSink();
+
+            OutputSink(const OutputSink&)            = delete;
+            OutputSink& operator=(const OutputSink&) = delete;
+
+            // The views in data keep their buffers alive until the write is done
+            void write(const std::filesystem::path& path, CarvedData data);
+
+            // Wait for all queued writes and complete the output. Rethrows the first error a write ran into
+            void finish();
+
+            // Whether paths end up as files on disk under the same name
+            virtual bool isDirectory() const { return false; }
+
+        protected:
+            // Store one file, called on the writer thread (or the caller's thread when synchronous)
+            virtual void store(const std::filesystem::path& path, const CarvedData& data) = 0;
+
+            // Called by finish once every write is stored
+            virtual void finalize() {}
+
+            // Stop the writer thread, derived sinks call this first in their destructor
+            void shutdown();
+
+        private:
+            void storeCounted(const std::filesystem::path& path, const CarvedData& data);
+            void writerLoop();
+
+        private:
+            bool   m_Async;
+            size_t m_MemoryLimit;
+
+            std::mutex                                               m_Mutex;
+            std::condition_variable                                  m_NotEmpty;
+            std::condition_variable                                  m_NotFull;
+            std::condition_variable                                  m_Drained;
+            std::deque<std::pair<std::filesystem::path, CarvedData>> m_Pending;
+            size_t                                                   m_PendingBytes = 0;
+            bool                                                     m_Writing      = false; // A batch is being stored
+            bool                                                     m_Stopping     = false;
+            std::exception_ptr                                       m_Error;
+            std::thread                                              m_Writer;
+        };
+
+        // Plain files. Directories are only created when opening a file fails, so a file normally costs one open
+        class DirectorySink : public OutputSink
+        {
+        public:
+            // A synchronous sink writes right away in the calling thread, like saving did before sinks
+            explicit DirectorySink(bool async = true, size_t memoryLimit = DEFAULT_MEMORY_LIMIT);
+            ~DirectorySink() override;
+
+            bool isDirectory() const override { return true; }
+
+        protected:
+            void store(const std::filesystem::path& path, const CarvedData& data) override;
+        };
+
+        // Everything in one archive file, written front to back. Entries are named by their path relative to basePath
+        class PackedSink : public OutputSink
+        {
+        public:
+            PackedSink(const std::string& archivePath, const std::string& basePath, size_t memoryLimit);
+
+        protected:
+            std::string entryName(const std::filesystem::path& path) const;
+
+        protected:
+            std::ofstream         m_Archive;
+            std::string           m_ArchivePath;
+            std::filesystem::path m_BasePath;
+            uint64_t              m_Offset = 0; // Bytes written to the archive so far
+        };
+
+        // A zip with stored (uncompressed) entries, switching to zip64 records only where sizes need it. Assets are
+        // PNGs (already deflated), MIDIs and WAVs, so storing keeps the writer thread cheap
+        class ZipSink : public PackedSink
+        {
+        public:
+            ZipSink(const std::string& archivePath,
+                    const std::string& basePath,
+                    size_t             memoryLimit = DEFAULT_MEMORY_LIMIT);
+            ~ZipSink() override;
+
+        protected:
+            void store(const std::filesystem::path& path, const CarvedData& data) override;
+            void finalize() override;
+
+        private:
+            struct Entry
+            {
+                std::string name;
+                uint32_t    crc;
+                uint64_t    size;
+                uint64_t    offset;
+            };
+
+            std::vector<Entry> m_Entries;
+        };
+
+        // A POSIX ustar stream, with GNU long names and base-256 sizes where ustar falls short
+        class TarSink : public PackedSink
+        {
+        public:
+            TarSink(const std::string& archivePath,
+                    const std::string& basePath,
+                    size_t             memoryLimit = DEFAULT_MEMORY_LIMIT);
+            ~TarSink() override;
+
+        protected:
+            void store(const std::filesystem::path& path, const CarvedData& data) override;
+            void finalize() override;
+
+        private:
+            void writeHeader(const std::string& name, uint64_t size, char type);
+            void pad(uint64_t size);
+        };
+
         template<typename FileType>
         class HunterBase
         {
         public:
             HunterBase() = default;
 
-            // Add a buffer to be searched
-            void addSourceBuffer(const std::vector<char>& buffer) { m_SourceBuffers.emplace_back(buffer); }
+            // Add a shared buffer to be searched, no bytes are copied
+            void addSourceBuffer(SharedBuffer buffer) { m_SourceBuffers.emplace_back(std::move(buffer)); }
+
+            // Add a buffer to be searched, pass an rvalue to avoid copying it
+            void addSourceBuffer(io::Buffer buffer) { addSourceBuffer(makeSharedBuffer(std::move(buffer))); }
+
+            // Add a buffer together with the signature matches of a previous scan (see HunterSet)
+            void addSourceBuffer(SharedBuffer buffer, search::MatchTable matches)
+            {
+                if (!buffer->empty())
+                    m_SourceMatches.emplace(buffer->data(), std::move(matches));
+                m_SourceBuffers.emplace_back(std::move(buffer));
+            }
+
+            // Add a buffer inflated from a stream inside another buffer, see io::inflateEmbeddedStreams. It is parsed
+            // on its own: no asset continues into it or out of it, so one spanning two entries is still carved
+            void addEmbeddedBuffer(SharedBuffer buffer, search::MatchTable matches = {})
+            {
+                if (!buffer->empty())
+                    m_EmbeddedBuffers.insert(buffer->data());
+                addSourceBuffer(std::move(buffer), std::move(matches));
+            }
+
+            // Pure virtual function to list the signatures searched by parseFiles
+            virtual std::vector<const search::BytePattern*> getSignatures() const = 0;
 
             // Pure virtual function to parse files from buffers, needs to be implemented by derived classes
             virtual std::vector<FileType> parseFiles() const = 0;
@@ -60,54 +898,812 @@ namespace jhunter
                                    const std::string&           outputDir,
                                    const std::string&           prefix) const = 0;
 
+            // Pure virtual function to save one file as <outputDir>/<prefix><index>, the directory must exist
+            virtual void saveFile(const FileType&    file,
+                                  const std::string& outputDir,
+                                  const std::string& prefix,
+                                  size_t             index) const = 0;
+
+            // Streaming mode: parse one buffer right away without keeping it. Assets spanning several buffers are
+            // carried over to the next call. Returns the assets completed by this buffer
+            std::vector<FileType> parseStreamBuffer(const SharedBuffer& buffer, search::MatchTable matches = {})
+            {
+                if (buffer->empty())
+                    return parseNextBuffer(buffer);
+
+                m_SourceMatches.insert_or_assign(buffer->data(), std::move(matches));
+                auto files = parseNextBuffer(buffer);
+                m_SourceMatches.erase(buffer->data());
+                return files;
+            }
+
+            // Streaming mode: parse an embedded buffer on its own, assets carried over in the stream wait for the
+            // next regular buffer
+            std::vector<FileType> parseEmbeddedBuffer(const SharedBuffer& buffer, search::MatchTable matches = {})
+            {
+                if (buffer->empty())
+                    return {};
+
+                m_SourceMatches.insert_or_assign(buffer->data(), std::move(matches));
+                auto files = parseStandaloneBuffer(buffer);
+                m_SourceMatches.erase(buffer->data());
+                return files;
+            }
+
+            // Pure virtual function to drop partial assets carried over in streaming mode
+            virtual void resetStream() = 0;
+
+            // Pure virtual function to end a stream: an asset still carried over is dropped and the buffers it ran
+            // through are searched. Returns the assets found there
+            virtual std::vector<FileType> finishStream() = 0;
+
         protected:
+            // Pure virtual function to parse the next buffer of a stream, needs to be implemented by derived classes
+            virtual std::vector<FileType> parseNextBuffer(const SharedBuffer& buffer) = 0;
+
+            // Pure virtual function to parse one buffer with nothing carried into or out of it
+            virtual std::vector<FileType> parseStandaloneBuffer(const SharedBuffer& buffer) const = 0;
+
+            bool isEmbedded(const SharedBuffer& buffer) const
+            {
+                return !buffer->empty() && m_EmbeddedBuffers.count(buffer->data()) > 0;
+            }
+
             // Utility function to find a sequence of bytes in a buffer starting at a specific position
-            size_t findSequenceInBuffer(const std::vector<char>& buffer, const std::string& seq, size_t startPos) const;
+            size_t findSequenceInBuffer(io::ByteSpan               buffer,
+                                        const search::BytePattern& pattern,
+                                        size_t                     startPos) const;
+
+            std::vector<SharedBuffer> m_SourceBuffers; // Buffers to be scanned
+
+            std::unordered_map<const char*, search::MatchTable> m_SourceMatches;   // Precomputed matches per buffer
+            std::unordered_set<const char*>                     m_EmbeddedBuffers; // Buffers parsed on their own
+        };
+
+        // Content hashes of saved assets, shared between hunters (and the jars of a batch) so every distinct asset is
+        // saved once. A duplicate is not written, it is listed in duplicates.tsv of its output directory instead
+        class AssetDedup
+        {
+        public:
+            // Register an asset about to be saved at path. Returns the path of the first asset with the same content
+            // and records path as a reference to it, or returns nullopt if this is the first. Thread-safe
+            std::optional<std::filesystem::path> claim(uint64_t hash, size_t size, const std::filesystem::path& path);
+
+            // Register an asset saved earlier (e.g. by a run whose results are cached) unless its content is known
+            void addOriginal(uint64_t hash, size_t size, const std::filesystem::path& path);
+
+            // Record a derived file (like the WAV of a MIDI) of a duplicate as a reference to the original one
+            void addReference(const std::filesystem::path& path, const std::filesystem::path& original);
+
+            // Write duplicates.tsv to every directory that got a duplicate. Each line is the skipped file name, a tab
+            // and the original's path relative to that directory
+            void writeManifests() const;
+            void writeManifests(OutputSink& sink) const;
+
+            // Whether the asset or derived file at path was skipped as a duplicate
+            bool isDuplicate(const std::filesystem::path& path) const;
+
+            size_t getDuplicateCount() const;
+
+        private:
+            struct Original
+            {
+                size_t                size;
+                std::filesystem::path path;
+            };
+
+            using Reference = std::pair<std::filesystem::path, std::filesystem::path>; // Skipped file and original
+
+            mutable std::mutex                                  m_Mutex;
+            std::unordered_map<uint64_t, std::vector<Original>> m_Originals;
+            std::vector<Reference>                              m_References;
+            std::unordered_set<std::string>                     m_ReferencePaths;
+            size_t                                              m_DuplicateCount = 0;
+        };
+
+        enum class AssetType : uint8_t
+        {
+            PNG,
+            MIDI
+        };
+
+        // Results of earlier runs, kept in a compact binary file. A jar whose central directory did not change since
+        // it was hunted into the same folder is skipped, and a MIDI rendered before is copied from its earlier WAV
+        // instead of rendered again. Carving carries state from entry to entry, so jars are the unit of reuse
+        class ResultCache
+        {
+        public:
+            using AssetType = hunter::AssetType;
+
+            struct Asset
+            {
+                AssetType   type;
+                uint64_t    hash;
+                uint64_t    size;
+                std::string fileName; // Relative to the output folder of the jar
+                bool        hasWAV = false;
+            };
+
+            struct JarRecord
+            {
+                std::string        jarPath;
+                uint64_t           fingerprint = 0; // See ZipArchive::getFingerprint
+                std::string        outPath;
+                std::vector<Asset> assets; // Assets saved, duplicates skipped by AssetDedup are left out
+            };
+
+            // Load cachePath if it exists and was written with the same settingsKey, start empty otherwise.
+            // settingsKey should change whenever an option that affects the output does
+            ResultCache(const std::string& cachePath, uint64_t settingsKey);
+
+            // Hash a description of the settings into a settings key
+            static uint64_t makeSettingsKey(std::string_view settings);
 
-            std::vector<std::vector<char>> m_SourceBuffers; // Buffers to be scanned
+            // The record of a jar that is unchanged and whose output files all still exist. Thread-safe
+            std::optional<JarRecord> findJar(const std::string& jarPath,
+                                             uint64_t           fingerprint,
+                                             const std::string& outPath) const;
+            void                     storeJar(JarRecord record);
+
+            // A WAV from an earlier run rendered from a MIDI with this content, if it still exists. Thread-safe
+            std::optional<std::filesystem::path> findRender(uint64_t hash, uint64_t size) const;
+
+            // Write the cache file if anything was stored
+            void save() const;
+
+        private:
+            std::string m_CachePath;
+            uint64_t    m_SettingsKey;
+            bool        m_Changed = false;
+
+            mutable std::mutex                                             m_Mutex;
+            std::unordered_map<std::string, JarRecord>                     m_Jars; // By jar path
+            std::unordered_map<uint64_t, std::pair<uint64_t, std::string>> m_Renders; // MIDI size and WAV by hash
         };
 
         struct PngFile
         {
-            std::vector<char> data;
+            CarvedData data;
+            uint64_t   contentHash = 0; // Hash of data, taken while it is hot from carving
+        };
+
+        struct PngHunterSettings
+        {
+            // Check the CRC of every chunk before accepting a PNG. Without it, only chunk headers are read
+            bool verifyCRC = false;
+
+            // The most bytes of a PNG carried over from the buffer it starts in into the next ones. Beyond that the
+            // signature is taken for a false one, so a junk chunk length can not swallow the entries after it
+            size_t maxSpanSize = 16 * 1024 * 1024;
+
+            // Skip PNGs whose content was already saved, see AssetDedup
+            std::shared_ptr<AssetDedup> dedup;
+
+            // Where PNGs are saved, plain files written right away if not set
+            std::shared_ptr<OutputSink> sink;
+
+            // No line for every saved file, errors are still reported
+            bool quiet = false;
         };
 
         class PngHunter : public HunterBase<PngFile>
         {
         public:
+            std::vector<const search::BytePattern*> getSignatures() const override;
+
             std::vector<PngFile> parseFiles() const override;
             void                 saveFiles(const std::vector<PngFile>& pngFiles,
                                            const std::string&          outputDir,
                                            const std::string&          prefix) const override;
+            void                 saveFile(const PngFile&     pngFile,
+                                          const std::string& outputDir,
+                                          const std::string& prefix,
+                                          size_t             index) const override;
+
+            void                 resetStream() override { m_StreamState = {}; }
+            std::vector<PngFile> finishStream() override;
+
+            void setSettings(const PngHunterSettings& settings);
+
+        protected:
+            std::vector<PngFile> parseNextBuffer(const SharedBuffer& buffer) override;
+            std::vector<PngFile> parseStandaloneBuffer(const SharedBuffer& buffer) const override;
+
+        private:
+            enum class ChunkWalk
+            {
+                NeedMore, // The buffer ended inside the PNG
+                Complete, // The IEND chunk was passed
+                Invalid   // Not a PNG after all, or a corrupt one
+            };
+
+            // A PNG is carved by walking its length-prefixed chunks. When a PNG continues in the next buffer,
+            // this is what carries the walk over
+            struct ParseState
+            {
+                CarvedData currentPng;         // Views of the ongoing PNG data
+                bool       pngStarted = false; // Flag to track if PNG start was found
+
+                std::array<unsigned char, 8> chunkHeader {};     // Length and type of the current chunk
+                size_t                       headerBytes   = 0; // Bytes of chunkHeader read so far
+                uint64_t                     dataRemaining = 0; // Chunk data left to skip
+                size_t                       crcBytes      = 0; // Bytes of the stored CRC read so far
+                uint32_t                     storedCRC     = 0;
+                uint32_t                     runningCRC    = 0; // CRC of the chunk type and data so far
+                size_t                       chunkCount    = 0;
+            };
+
+            void parseBuffer(const SharedBuffer& source, ParseState& state, std::vector<PngFile>& pngFiles) const;
+
+            // parseBuffer without the stats, searching from start
+            void searchBuffer(const SharedBuffer&   source,
+                              size_t                start,
+                              ParseState&           state,
+                              std::vector<PngFile>& pngFiles) const;
+
+            // Drop the PNG carried over in state and search the buffers it ran through, which may carry over again
+            void rescanCarryOver(ParseState& state, std::vector<PngFile>& pngFiles) const;
+
+            // Walk chunks from pos until the PNG ends, the buffer ends or the data turns out to be invalid
+            ChunkWalk walkChunks(io::ByteSpan buffer, size_t& pos, ParseState& state) const;
+
+            PngHunterSettings m_Settings;
+            ParseState        m_StreamState;
         };
 
         struct MidiFile
         {
-            std::vector<char> data;
+            CarvedData data;
+            uint64_t   contentHash = 0; // Hash of data, taken while it is hot from carving
+        };
+
+        // How the synths of a SynthPool render. Lower rates, fewer voices and cheaper interpolation trade quality for
+        // render speed, e.g. for previews
+        struct SynthSettings
+        {
+            int sampleRate    = 44100;                // Standard sample rate
+            int polyphony     = 256;                  // Voices played at once, FluidSynth's default
+            int interpolation = FLUID_INTERP_DEFAULT; // One of FluidSynth's fluid_interp values
+        };
+
+        // FluidSynth instances sharing one loaded SoundFont, so rendering many MIDIs only parses the SoundFont once.
+        // A synth is handed out to one render at a time and replaced by a fresh one when given back, which keeps
+        // every render starting from the same state as a newly created synth
+        class SynthPool
+        {
+        public:
+            SynthPool(const std::string& soundFontPath, size_t size, const SynthSettings& settings = {});
+            ~SynthPool();
+
+            SynthPool(const SynthPool&)            = delete;
+            SynthPool& operator=(const SynthPool&) = delete;
+
+            // Blocks until a synth is free. Thread-safe
+            fluid_synth_t* acquire();
+            void           release(fluid_synth_t* synth);
+
+            int                  getSampleRate() const { return m_Synth.sampleRate; }
+            const SynthSettings& getSynthSettings() const { return m_Synth; }
+            size_t               size() const { return m_Size; }
+            const std::string&   getSoundFontPath() const { return m_SoundFontPath; }
+
+        private:
+            fluid_synth_t* createSynth();
+            void           destroySynth(fluid_synth_t* synth);
+
+        private:
+            std::string       m_SoundFontPath;
+            size_t            m_Size       = 0;
+            SynthSettings     m_Synth;
+            fluid_settings_t* m_Settings   = nullptr;
+            fluid_synth_t*    m_Loader     = nullptr; // Owns the SoundFont
+            fluid_sfont_t*    m_SoundFont  = nullptr;
+
+            std::vector<fluid_synth_t*> m_IdleSynths;
+            std::mutex                  m_Mutex;
+            std::condition_variable     m_SynthReleased;
+        };
+
+        // Why a WAV render stopped before the MIDI ended
+        enum class RenderLimit
+        {
+            None,     // Rendered to the end
+            Duration, // MidiHunterSettings::maxRenderDuration of audio was rendered
+            Time,     // MidiHunterSettings::renderTimeBudget ran out
+            Silence   // Silent for MidiHunterSettings::silenceCutoff after the last sound
+        };
+
+        const char* getRenderLimitName(RenderLimit limit);
+
+        // A MIDI rendered to a WAV in the format of MidiHunterSettings
+        struct WavRender
+        {
+            io::Buffer  data;
+            uint64_t    frames = 0;
+            RenderLimit limit  = RenderLimit::None;
         };
 
         struct MidiHunterSettings
         {
             bool exportWAV = true;
 
+            // The most bytes of a MIDI carried over from the buffer it starts in into the next ones, see
+            // PngHunterSettings::maxSpanSize
+            size_t maxSpanSize = 16 * 1024 * 1024;
+
+            // Limits of a single WAV render, 0 for none. A render that hits one ends at that point with a short fade
+            // out, so a broken carve or a long silent tail can not stall the hunt or produce a huge WAV
+            std::chrono::milliseconds maxRenderDuration {0}; // Of audio
+            std::chrono::milliseconds renderTimeBudget {0};  // Of wall-clock time
+            std::chrono::milliseconds silenceCutoff {0};     // Of silence once something was heard
+
+            // Times the MIDI is played in a row, for tunes made to loop
+            int loopCount = 1;
+
+            // Rate, voices and interpolation of the synths, used when the pool is created from soundFontPath. A pool
+            // passed in as synthPool brings its own
+            SynthSettings synth {};
+
+            // Format of the WAVs: 1 channel mixes both sides down, 32 bits writes float samples instead of 16-bit PCM
+            int channels      = 2;
+            int bitsPerSample = 16;
+
+            // Render float samples and convert them with SIMD, instead of letting FluidSynth write 16-bit samples.
+            // Always the case for mono and float WAVs
+            bool floatRender = false;
+
+            // Add triangular dither when float samples are converted to 16 bits
+            bool dither = true;
+
             std::string soundFontPath;
+
+            // WAVs rendered at once by saveFiles, 0 means one per hardware thread
+            size_t renderThreads = 1;
+
+            // Optional pool to share between hunters, one is created from soundFontPath on first use otherwise
+            std::shared_ptr<SynthPool> synthPool;
+
+            // Skip MIDIs whose content was already saved, along with rendering them again. See AssetDedup
+            std::shared_ptr<AssetDedup> dedup;
+
+            // Copy WAVs rendered by an earlier run from a MIDI with the same content. See ResultCache
+            std::shared_ptr<ResultCache> cache;
+
+            // Where MIDIs and WAVs are saved, plain files written right away if not set
+            std::shared_ptr<OutputSink> sink;
+
+            // No line for every saved, skipped or rendered file, errors are still reported
+            bool quiet = false;
         };
 
         class MidiHunter : public HunterBase<MidiFile>
         {
         public:
+            std::vector<const search::BytePattern*> getSignatures() const override;
+
             std::vector<MidiFile> parseFiles() const override;
             void                  saveFiles(const std::vector<MidiFile>& midiFiles,
                                             const std::string&           outputDir,
                                             const std::string&           prefix) const override;
+            void                  saveFile(const MidiFile&    midiFile,
+                                           const std::string& outputDir,
+                                           const std::string& prefix,
+                                           size_t             index) const override;
+
+            void                  resetStream() override { m_StreamState = {}; }
+            std::vector<MidiFile> finishStream() override;
 
             void setSettings(const MidiHunterSettings& settings);
 
+            // Render a MIDI within the limits of the settings. nullopt if there is no SoundFont or FluidSynth
+            // rejects the MIDI. Thread-safe, every call borrows a synth of its own
+            std::optional<WavRender> renderWAV(const MidiFile& midiFile) const;
+
+        protected:
+            std::vector<MidiFile> parseNextBuffer(const SharedBuffer& buffer) override;
+            std::vector<MidiFile> parseStandaloneBuffer(const SharedBuffer& buffer) const override;
+
         private:
-            void exportWAVFile(const std::string& midiFileName, const std::string& outputFileName) const;
+            enum class ChunkWalk
+            {
+                NeedMore, // The buffer ended inside the MIDI
+                Complete, // The last track chunk was passed
+                Invalid   // Not a standard MIDI file after all, or a corrupt one
+            };
+
+            // A MIDI is carved by reading the track count from MThd and walking the length-prefixed chunks up to
+            // the last MTrk. When a MIDI continues in the next buffer, this is what carries the walk over
+            struct ParseState
+            {
+                CarvedData currentMidi;         // Views of the ongoing MIDI data
+                bool       midiStarted = false; // Flag to track if MIDI start was found
+
+                std::array<unsigned char, 8> chunkHeader {};       // Type and length of the current chunk
+                size_t                       headerBytes     = 0; // Bytes of chunkHeader read so far
+                std::array<unsigned char, 6> midiHeader {};        // Format, track count and division from MThd
+                uint64_t                     dataRemaining   = 0; // Chunk data left to skip
+                uint64_t                     dataRead        = 0; // Chunk data passed so far
+                size_t                       tracksRemaining = 0;
+                size_t                       chunkCount      = 0;
+            };
+
+            void parseBuffer(const SharedBuffer& source, ParseState& state, std::vector<MidiFile>& midiFiles) const;
+
+            // parseBuffer without the stats, searching from start
+            void searchBuffer(const SharedBuffer&    source,
+                              size_t                 start,
+                              ParseState&            state,
+                              std::vector<MidiFile>& midiFiles) const;
+
+            // Drop the MIDI carried over in state and search the buffers it ran through, which may carry over again
+            void rescanCarryOver(ParseState& state, std::vector<MidiFile>& midiFiles) const;
+
+            // Walk chunks from pos until the last track ends, the buffer ends or the data turns out to be invalid
+            ChunkWalk walkChunks(io::ByteSpan buffer, size_t& pos, ParseState& state) const;
+
+            // Returns the path written, or nullopt if the MIDI was a duplicate and not written
+            std::optional<std::filesystem::path> writeMidiFile(const MidiFile&    midiFile,
+                                                               const std::string& outputDir,
+                                                               const std::string& prefix,
+                                                               size_t             index) const;
+
+            void exportWAVFile(const MidiFile& midiFile, const std::filesystem::path& outputFileName) const;
+
+            // Copy the WAV of an identical MIDI from an earlier run, if the cache has one
+            bool reuseWAVFile(const MidiFile& midiFile, const std::filesystem::path& outputFileName) const;
+
+            OutputSink& getSink() const;
+
+            // The pool of the settings, or the one created on first use. Null if the SoundFont failed to load
+            SynthPool* getSynthPool() const;
 
         private:
             MidiHunterSettings m_Settings;
+            ParseState         m_StreamState;
+
+            mutable std::shared_ptr<SynthPool> m_OwnSynthPool;
+            mutable bool                       m_SynthPoolFailed = false;
+            mutable std::mutex                 m_SynthPoolMutex;
+        };
+
+        // A hunter that can take buffers with precomputed signature matches
+        template<typename Hunter>
+        concept FusableHunter = std::default_initializable<Hunter> &&
+                                requires(Hunter& hunter, SharedBuffer buffer, search::MatchTable matches) {
+                                    {
+                                        hunter.getSignatures()
+                                    } -> std::same_as<std::vector<const search::BytePattern*>>;
+                                    hunter.addSourceBuffer(buffer, std::move(matches));
+                                    hunter.addEmbeddedBuffer(buffer, std::move(matches));
+                                    hunter.parseStreamBuffer(buffer, std::move(matches));
+                                    hunter.parseEmbeddedBuffer(buffer, std::move(matches));
+                                    hunter.resetStream();
+                                    hunter.finishStream();
+                                };
+
+        // Several hunters fed by one fused scan: the signatures of all hunters are merged into a single
+        // automaton, every buffer is walked once and each hunter receives the matches of its own signatures
+        template<FusableHunter... Hunters>
+        class HunterSet
+        {
+        public:
+            HunterSet()
+            {
+                std::apply([this](auto&... hunter) { (addSignatures(hunter), ...); }, m_Hunters);
+                m_Automaton.compile();
+            }
+
+            // Scan a shared buffer once and hand it to every hunter, no bytes are copied
+            void addSourceBuffer(const SharedBuffer& buffer)
+            {
+                auto matches = scan(*buffer);
+
+                size_t index = 0;
+                std::apply(
+                    [&](auto&... hunter) {
+                        (hunter.addSourceBuffer(buffer, matches.select(m_Signatures[index++])), ...);
+                    },
+                    m_Hunters);
+            }
+
+            // Add a buffer, pass an rvalue to avoid copying it
+            void addSourceBuffer(io::Buffer buffer) { addSourceBuffer(makeSharedBuffer(std::move(buffer))); }
+
+            // Scan a buffer inflated from an embedded stream once and hand it to every hunter to parse on its own
+            void addEmbeddedBuffer(const SharedBuffer& buffer)
+            {
+                auto matches = scan(*buffer);
+
+                size_t index = 0;
+                std::apply(
+                    [&](auto&... hunter) {
+                        (hunter.addEmbeddedBuffer(buffer, matches.select(m_Signatures[index++])), ...);
+                    },
+                    m_Hunters);
+            }
+
+            // Streaming mode: scan one buffer and call onFiles(hunterIndex, hunter, files) for every hunter that
+            // completed assets with it. Nothing is kept except the assets still spanning into the next buffer
+            template<typename Callback>
+            void parseStreamBuffer(const SharedBuffer& buffer, Callback&& onFiles)
+            {
+                parseStream(buffer, false, onFiles);
+            }
+
+            // Streaming mode: like parseStreamBuffer for a buffer inflated from an embedded stream, which is parsed
+            // on its own
+            template<typename Callback>
+            void parseEmbeddedBuffer(const SharedBuffer& buffer, Callback&& onFiles)
+            {
+                parseStream(buffer, true, onFiles);
+            }
+
+            // Streaming mode: the last buffer was parsed, see HunterBase::finishStream
+            template<typename Callback>
+            void finishStream(Callback&& onFiles)
+            {
+                [&]<size_t... Index>(std::index_sequence<Index...>) {
+                    (
+                        [&] {
+                            auto& hunter = std::get<Index>(m_Hunters);
+                            auto  files  = hunter.finishStream();
+                            if (!files.empty())
+                                onFiles(Index, hunter, std::move(files));
+                        }(),
+                        ...);
+                }(std::index_sequence_for<Hunters...> {});
+            }
+
+            // Run the streaming pipeline over a whole archive: a producer inflates entries, this set hunts them as
+            // they arrive and every completed asset is written right away as <outputDir>/<prefix><index>, with one
+            // prefix per hunter. Stages are connected by bounded queues, so memory does not grow with the archive
+            void huntStreaming(const io::ZipArchive&                                archive,
+                               const std::string&                                   outputDir,
+                               const std::array<std::string, sizeof...(Hunters)>& prefixes,
+                               const pipeline::StreamSettings&                      settings = {})
+            {
+                std::filesystem::create_directories(outputDir);
+                std::apply([](auto&... hunter) { (hunter.resetStream(), ...); }, m_Hunters);
+
+                pipeline::BoundedQueue<SharedBuffer>          buffers(settings.memoryLimit / 4);
+                pipeline::BoundedQueue<std::function<void()>> writes(settings.memoryLimit / 2);
+                std::exception_ptr                            producerError;
+                std::exception_ptr                            hunterError;
+
+                // Stage 1: inflate entries in archive order
+                std::thread producer([&] {
+                    try
+                    {
+                        auto onEntry = [&](size_t, SharedBuffer buffer) {
+                            size_t size = buffer->size();
+                            return buffers.push(std::move(buffer), size);
+                        };
+                        archive.streamEntries(settings.inflateThreads, onEntry, settings.memoryLimit / 4);
+                    }
+                    catch (...)
+                    {
+                        producerError = std::current_exception();
+                    }
+                    buffers.close();
+                });
+
+                // Stage 2: hunt, numbering assets per hunter in the order they complete
+                std::thread hunting([&] {
+                    try
+                    {
+                        std::array<size_t, sizeof...(Hunters)> counters {};
+                        auto onFiles = [&](size_t hunterIndex, const auto& hunter, auto&& files) {
+                            for (auto& file : files)
+                            {
+                                size_t size  = file.data.size();
+                                size_t index = counters[hunterIndex]++;
+                                writes.push(
+                                    [&hunter, &outputDir, &prefix = prefixes[hunterIndex], file = std::move(file), index] {
+                                        hunter.saveFile(file, outputDir, prefix, index);
+                                    },
+                                    size);
+                            }
+                        };
+
+                        while (auto buffer = buffers.pop())
+                        {
+                            parseStreamBuffer(*buffer, onFiles);
+
+                            // Streams inside the entry are hunted right after it, in the order they were found
+                            if (settings.embedded)
+                            {
+                                for (auto& stream : io::inflateEmbeddedStreams(**buffer, *settings.embedded))
+                                    parseEmbeddedBuffer(makeSharedBuffer(std::move(stream)), onFiles);
+                            }
+                        }
+                        finishStream(onFiles);
+                    }
+                    catch (...)
+                    {
+                        hunterError = std::current_exception();
+                        buffers.cancel();
+                    }
+                    writes.close();
+                });
+
+                // Stage 3: write on the calling thread
+                try
+                {
+                    while (auto write = writes.pop())
+                        (*write)();
+                }
+                catch (...)
+                {
+                    buffers.cancel();
+                    writes.cancel();
+                    producer.join();
+                    hunting.join();
+                    throw;
+                }
+
+                producer.join();
+                hunting.join();
+
+                if (hunterError)
+                    std::rethrow_exception(hunterError);
+                if (producerError)
+                    std::rethrow_exception(producerError);
+            }
+
+            template<typename Hunter>
+            Hunter& get()
+            {
+                return std::get<Hunter>(m_Hunters);
+            }
+
+            template<typename Hunter>
+            const Hunter& get() const
+            {
+                return std::get<Hunter>(m_Hunters);
+            }
+
+        private:
+            template<typename Hunter>
+            void addSignatures(const Hunter& hunter)
+            {
+                auto& signatures = m_Signatures.emplace_back(hunter.getSignatures());
+                for (const auto* signature : signatures)
+                    m_Automaton.addPattern(signature);
+            }
+
+            template<typename Callback>
+            void parseStream(const SharedBuffer& buffer, bool embedded, Callback& onFiles)
+            {
+                auto matches = scan(*buffer);
+
+                [&]<size_t... Index>(std::index_sequence<Index...>) {
+                    (
+                        [&] {
+                            auto& hunter  = std::get<Index>(m_Hunters);
+                            auto  matched = matches.select(m_Signatures[Index]);
+                            auto  files   = embedded ? hunter.parseEmbeddedBuffer(buffer, std::move(matched)) :
+                                                       hunter.parseStreamBuffer(buffer, std::move(matched));
+                            if (!files.empty())
+                                onFiles(Index, hunter, std::move(files));
+                        }(),
+                        ...);
+                }(std::index_sequence_for<Hunters...> {});
+            }
+
+            search::MatchTable scan(io::ByteSpan buffer) const
+            {
+                stats::ScopedTimer timer(stats::Counter::ScanNanos);
+                stats::add(stats::Counter::BytesScanned, buffer.size());
+                return m_Automaton.scan(buffer.data(), buffer.size());
+            }
+
+            std::tuple<Hunters...>                               m_Hunters;
+            std::vector<std::vector<const search::BytePattern*>> m_Signatures; // Signatures per hunter
+            search::MultiPattern                                 m_Automaton;
         };
+
+        // Where a carved asset starts
+        struct AssetSource
+        {
+            size_t      entryIndex = 0; // Entry of the archive holding the first byte
+            std::string entryName;
+            size_t      offset      = 0;     // Of the first byte, in the entry or in the stream when embedded
+            bool        embedded    = false; // Found in a compressed stream inside the entry
+            size_t      streamIndex = 0;     // Of that stream, in the order io::inflateEmbeddedStreams returns them
+        };
+
+        // An asset as soon as it is carved, its bytes are views into the entries it came from
+        struct FoundAsset
+        {
+            AssetType   type;
+            CarvedData  data;
+            uint64_t    contentHash = 0;
+            AssetSource source;
+        };
+
+        struct HuntSettings
+        {
+            // Threads inflating entries and embedded stream hunting. memoryLimit caps the entries inflated ahead of
+            // their turn, and for an AssetStream also the bytes of the assets waiting to be taken
+            pipeline::StreamSettings stream;
+
+            // Check the CRC of every PNG chunk, see PngHunterSettings
+            bool verifyPngCRC = false;
+
+            // Stops the hunt from another thread, checked before every entry and asset
+            std::stop_token stopToken;
+        };
+
+        // Called with each asset in the order they complete, return false to stop hunting
+        using AssetCallback = std::function<bool(FoundAsset&& asset)>;
+
+        // Hunt PNGs and MIDIs in an archive and hand each one to onAsset as soon as it is carved, while later entries
+        // are still being inflated. Nothing is written or rendered. Returns false if it was stopped early, by onAsset or
+        // by the stop token
+        bool huntAssets(const io::ZipArchive& archive, const AssetCallback& onAsset, const HuntSettings& settings = {});
+
+        // huntAssets the other way round: a background thread hunts ahead and the caller takes assets one by one, like
+        // from a generator. Destroying the stream before the end cancels the hunt
+        class AssetStream
+        {
+        public:
+            explicit AssetStream(const std::string& jarPath, HuntSettings settings = {});
+            ~AssetStream();
+
+            AssetStream(const AssetStream&)            = delete;
+            AssetStream& operator=(const AssetStream&) = delete;
+
+            // Block until the next asset is carved. Returns nullopt once the archive is done or the hunt was
+            // cancelled, and rethrows the error the hunt stopped on if there was one
+            std::optional<FoundAsset> next();
+
+            // Stop hunting and drop the assets not taken yet. Thread-safe
+            void cancel();
+
+        private:
+            pipeline::BoundedQueue<FoundAsset> m_Assets;
+            std::stop_source                   m_Stop;
+            std::exception_ptr                 m_Error;
+            std::thread                        m_Hunter;
+        };
+
+        // What an asset is and where it lies, without its bytes
+        struct ManifestRecord
+        {
+            AssetType   type;
+            AssetSource source;
+            uint64_t    size        = 0;
+            uint64_t    contentHash = 0; // See CarvedData::contentHash
+            uint32_t    width       = 0; // Of a PNG, from its IHDR chunk
+            uint32_t    height      = 0;
+            uint16_t    trackCount  = 0; // Of a MIDI, from its header
+        };
+
+        // Every asset of a jar in the order it was carved, to catalog a jar without extracting anything
+        struct Manifest
+        {
+            std::string                 jarPath;
+            uint64_t                    fingerprint = 0; // See ZipArchive::getFingerprint
+            std::vector<ManifestRecord> records;
+
+            std::string toJson() const;
+
+            // Write in a compact binary layout, which load reads back
+            void            save(const std::string& path) const;
+            static Manifest load(const std::string& path);
+        };
+
+        // The manifest record of a carved asset
+        ManifestRecord describeAsset(const FoundAsset& asset);
+
+        // Hunt an archive with huntAssets and keep the manifest records only. Nothing is written or rendered
+        Manifest buildManifest(const io::ZipArchive& archive, const HuntSettings& settings = {});
+
+        // Read one asset of a manifest back from its archive, without hunting. The archive must be opened with the
+        // same entry filter, and settings.stream.embedded must match the hunt for an embedded asset. Throws
+        // std::runtime_error if the bytes found there are not the asset anymore
+        CarvedData loadAsset(const io::ZipArchive&  archive,
+                             const ManifestRecord& record,
+                             const HuntSettings&   settings = {});
     } // namespace hunter
 } // namespace jhunter
\ No newline at end of file
@@ -1,417 +1,5191 @@
 #include "j2me-asset-hunter/lib.hpp"
 
 #include <fluidsynth.h>
+#include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdint>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define JHUNTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define JHUNTER_ARM_CRC 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <arm_acle.h>
+#endif
+#if defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JHUNTER_TARGET_SSE2 __attribute__((target("sse2")))
+#define JHUNTER_TARGET_AVX2 __attribute__((target("avx2")))
+#define JHUNTER_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#define JHUNTER_TARGET_ARM_CRC __attribute__((target("+crc")))
+#else
+#define JHUNTER_TARGET_SSE2
+#define JHUNTER_TARGET_AVX2
+#define JHUNTER_TARGET_PCLMUL
+#define JHUNTER_TARGET_ARM_CRC
+#endif
 
 namespace
 {
-    void writeWavHeader(std::ofstream& file, int sampleRate, int numChannels, int bitsPerSample, int dataSize)
-    {
-        // Write the RIFF header
-        file.write("RIFF", 4);                                    // Chunk ID
-        int32_t chunkSize = 36 + dataSize;                        // Chunk size
-        file.write(reinterpret_cast<const char*>(&chunkSize), 4); // Chunk size
-        file.write("WAVE", 4);                                    // Format
-
-        // Write the fmt subchunk
-        file.write("fmt ", 4);                                           // Subchunk1 ID
-        int32_t subchunk1Size = 16;                                      // Subchunk1 size (16 for PCM)
-        file.write(reinterpret_cast<const char*>(&subchunk1Size), 4);
-        int16_t audioFormat = 1;                                         // Audio format (1 for PCM)
-        file.write(reinterpret_cast<const char*>(&audioFormat), 2);
-        file.write(reinterpret_cast<const char*>(&numChannels), 2);      // Number of channels
-        file.write(reinterpret_cast<const char*>(&sampleRate), 4);       // Sample rate
-        int32_t byteRate = sampleRate * numChannels * bitsPerSample / 8; // Byte rate
-        file.write(reinterpret_cast<const char*>(&byteRate), 4);
-        int16_t blockAlign = numChannels * bitsPerSample / 8;            // Block align
-        file.write(reinterpret_cast<const char*>(&blockAlign), 2);
-        file.write(reinterpret_cast<const char*>(&bitsPerSample), 2);    // Bits per sample
-
-        // Write the data subchunk
-        file.write("data", 4);                                   // Subchunk2 ID
-        file.write(reinterpret_cast<const char*>(&dataSize), 4); // Subchunk2 size
+    using jhunter::search::Kernel;
+
+    constexpr size_t NPOS = jhunter::search::BytePattern::npos;
+
+    constexpr uint32_t AC_ROOT             = 0;
+    constexpr uint32_t AC_MISSING          = UINT32_MAX;
+    constexpr size_t   AC_SIMD_MAX_FILTERS = 8; // Beyond this, root state skipping uses the scalar filter
+
+    // Plain memchr + memcmp search, used for short needles, tails and CPUs without SIMD
+    size_t findScalar(const char* data, size_t size, const char* needle, size_t needleSize, size_t startPos)
+    {
+        if (needleSize == 0)
+            return startPos <= size ? startPos : NPOS;
+        if (size < needleSize || startPos > size - needleSize)
+            return NPOS;
+
+        const char* cursor = data + startPos;
+        const char* last   = data + (size - needleSize); // Last valid start of a match
+        while (cursor <= last)
+        {
+            const void* hit = std::memchr(cursor, static_cast<unsigned char>(needle[0]), last - cursor + 1);
+            if (!hit)
+                return NPOS;
+
+            cursor = static_cast<const char*>(hit);
+            if (std::memcmp(cursor + 1, needle + 1, needleSize - 1) == 0)
+                return cursor - data;
+            ++cursor;
+        }
+        return NPOS;
     }
-} // namespace
 
-namespace jhunter
-{
-    namespace cli
-    {}
+    // First/last byte pairs of several patterns, a position is a candidate if any pair matches there
+    struct CandidateFilter
+    {
+        const char*   firstBytes;
+        const char*   lastBytes;
+        const size_t* lastOffsets; // Pattern size - 1
+        size_t        count;
+        size_t        maxLastOffset;
+    };
+
+    bool isCandidate(const char* data, size_t size, const CandidateFilter& filter, size_t pos)
+    {
+        for (size_t k = 0; k < filter.count; ++k)
+        {
+            size_t lastPos = pos + filter.lastOffsets[k];
+            if (lastPos < size && data[pos] == filter.firstBytes[k] && data[lastPos] == filter.lastBytes[k])
+                return true;
+        }
+        return false;
+    }
+
+    size_t findCandidateScalar(const char* data, size_t size, const CandidateFilter& filter, size_t pos)
+    {
+        for (; pos < size; ++pos)
+        {
+            if (isCandidate(data, size, filter, pos))
+                return pos;
+        }
+        return size;
+    }
+
+#ifdef JHUNTER_X86
+    // SIMD first-byte/last-byte filter: compare a block of candidate starts against the first
+    // and last needle bytes at once, and only run memcmp on positions where both match.
+    JHUNTER_TARGET_SSE2 size_t
+    findSSE2(const char* data, size_t size, const char* needle, size_t needleSize, size_t startPos)
+    {
+        if (needleSize < 2 || size < needleSize || startPos > size - needleSize)
+            return findScalar(data, size, needle, needleSize, startPos);
+
+        const __m128i first     = _mm_set1_epi8(needle[0]);
+        const __m128i last      = _mm_set1_epi8(needle[needleSize - 1]);
+        const size_t  lastStart = size - needleSize;
+
+        // Candidate mask of 16 starts beginning at offset
+        auto candidates = [&](size_t offset) JHUNTER_TARGET_SSE2 {
+            const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+            const __m128i blockLast  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + needleSize - 1));
+            return _mm_and_si128(_mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast));
+        };
+
+        size_t i = startPos;
+        for (; i + 31 <= lastStart; i += 32)
+        {
+            // Two blocks per iteration, most blocks have no candidate at all
+            const __m128i lo = candidates(i);
+            const __m128i hi = candidates(i + 16);
+            if (_mm_movemask_epi8(_mm_or_si128(lo, hi)) == 0)
+                continue;
+
+            auto mask = static_cast<uint32_t>(_mm_movemask_epi8(lo)) |
+                        (static_cast<uint32_t>(_mm_movemask_epi8(hi)) << 16);
+            while (mask != 0)
+            {
+                size_t candidate = i + std::countr_zero(mask);
+                if (std::memcmp(data + candidate + 1, needle + 1, needleSize - 2) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+
+        return findScalar(data, size, needle, needleSize, i);
+    }
+
+    JHUNTER_TARGET_AVX2 size_t
+    findAVX2(const char* data, size_t size, const char* needle, size_t needleSize, size_t startPos)
+    {
+        if (needleSize < 2 || size < needleSize || startPos > size - needleSize)
+            return findScalar(data, size, needle, needleSize, startPos);
+
+        const __m256i first     = _mm256_set1_epi8(needle[0]);
+        const __m256i last      = _mm256_set1_epi8(needle[needleSize - 1]);
+        const size_t  lastStart = size - needleSize;
+
+        // Candidate mask of 32 starts beginning at offset
+        auto candidates = [&](size_t offset) JHUNTER_TARGET_AVX2 {
+            const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+            const __m256i blockLast =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset + needleSize - 1));
+            return _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst), _mm256_cmpeq_epi8(last, blockLast));
+        };
+
+        size_t i = startPos;
+        for (; i + 63 <= lastStart; i += 64)
+        {
+            // Two blocks per iteration, most blocks have no candidate at all
+            const __m256i lo = candidates(i);
+            const __m256i hi = candidates(i + 32);
+            if (_mm256_testz_si256(_mm256_or_si256(lo, hi), _mm256_or_si256(lo, hi)))
+                continue;
+
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo)) |
+                            (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32);
+            while (mask != 0)
+            {
+                size_t candidate = i + std::countr_zero(mask);
+                if (std::memcmp(data + candidate + 1, needle + 1, needleSize - 2) == 0)
+                    return candidate;
+                mask &= mask - 1;
+            }
+        }
+
+        return findSSE2(data, size, needle, needleSize, i);
+    }
+
+    // The filter count is a template parameter so the per-pattern loop unrolls and the broadcast bytes stay in registers.
+    // The last full block is loaded overlapping the previous one, which leaves only the few positions where the
+    // longest pattern no longer fits to the scalar loop.
+    template<size_t Count>
+    JHUNTER_TARGET_SSE2 size_t findCandidateSSE2(const char* data, size_t size, const CandidateFilter& filter, size_t pos)
+    {
+        if (size < filter.maxLastOffset + 16 || pos >= size)
+            return findCandidateScalar(data, size, filter, pos);
+
+        __m128i firsts[Count];
+        __m128i lasts[Count];
+        size_t  lastOffsets[Count];
+        for (size_t k = 0; k < Count; ++k)
+        {
+            firsts[k]      = _mm_set1_epi8(filter.firstBytes[k]);
+            lasts[k]       = _mm_set1_epi8(filter.lastBytes[k]);
+            lastOffsets[k] = filter.lastOffsets[k];
+        }
+
+        auto blockMask = [&](size_t blockPos) JHUNTER_TARGET_SSE2 {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + blockPos));
+            __m128i       hits  = _mm_setzero_si128();
+            for (size_t k = 0; k < Count; ++k)
+            {
+                const __m128i blockLast =
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + blockPos + lastOffsets[k]));
+                hits = _mm_or_si128(hits,
+                                    _mm_and_si128(_mm_cmpeq_epi8(block, firsts[k]), _mm_cmpeq_epi8(blockLast, lasts[k])));
+            }
+            return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        };
+
+        const size_t lastBlock = size - filter.maxLastOffset - 16;
+        for (; pos <= lastBlock; pos += 16)
+        {
+            uint32_t mask = blockMask(pos);
+            if (mask != 0)
+                return pos + std::countr_zero(mask);
+        }
+
+        // Overlapping tail block, ignoring positions already checked
+        if (pos < lastBlock + 16)
+        {
+            uint32_t mask = blockMask(lastBlock) >> (pos - lastBlock);
+            if (mask != 0)
+                return pos + std::countr_zero(mask);
+            pos = lastBlock + 16;
+        }
+
+        return findCandidateScalar(data, size, filter, pos);
+    }
+
+    template<size_t Count>
+    JHUNTER_TARGET_AVX2 size_t findCandidateAVX2(const char* data, size_t size, const CandidateFilter& filter, size_t pos)
+    {
+        if (size < filter.maxLastOffset + 32 || pos >= size)
+            return findCandidateSSE2<Count>(data, size, filter, pos);
+
+        __m256i firsts[Count];
+        __m256i lasts[Count];
+        size_t  lastOffsets[Count];
+        for (size_t k = 0; k < Count; ++k)
+        {
+            firsts[k]      = _mm256_set1_epi8(filter.firstBytes[k]);
+            lasts[k]       = _mm256_set1_epi8(filter.lastBytes[k]);
+            lastOffsets[k] = filter.lastOffsets[k];
+        }
+
+        auto blockHits = [&](size_t blockPos) JHUNTER_TARGET_AVX2 {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + blockPos));
+            __m256i       hits  = _mm256_setzero_si256();
+            for (size_t k = 0; k < Count; ++k)
+            {
+                const __m256i blockLast =
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + blockPos + lastOffsets[k]));
+                hits = _mm256_or_si256(
+                    hits, _mm256_and_si256(_mm256_cmpeq_epi8(block, firsts[k]), _mm256_cmpeq_epi8(blockLast, lasts[k])));
+            }
+            return hits;
+        };
+
+        const size_t lastBlock = size - filter.maxLastOffset - 32;
+        for (; pos + 32 <= lastBlock; pos += 64)
+        {
+            // Two blocks per iteration, most blocks have no candidate at all
+            const __m256i lo   = blockHits(pos);
+            const __m256i hi   = blockHits(pos + 32);
+            const __m256i hits = _mm256_or_si256(lo, hi);
+            if (_mm256_testz_si256(hits, hits))
+                continue;
+
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(lo)) |
+                            (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32);
+            return pos + std::countr_zero(mask);
+        }
+
+        for (; pos <= lastBlock; pos += 32)
+        {
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(blockHits(pos)));
+            if (mask != 0)
+                return pos + std::countr_zero(mask);
+        }
+
+        // Overlapping tail block, ignoring positions already checked
+        if (pos < lastBlock + 32)
+        {
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(blockHits(lastBlock))) >> (pos - lastBlock);
+            if (mask != 0)
+                return pos + std::countr_zero(mask);
+            pos = lastBlock + 32;
+        }
+
+        return findCandidateScalar(data, size, filter, pos);
+    }
+
+    template<size_t Count = 1>
+    size_t findCandidateSIMD(Kernel kernel, const char* data, size_t size, const CandidateFilter& filter, size_t pos)
+    {
+        if constexpr (Count < AC_SIMD_MAX_FILTERS)
+        {
+            if (filter.count > Count)
+                return findCandidateSIMD<Count + 1>(kernel, data, size, filter, pos);
+        }
+
+        return kernel == Kernel::AVX2 ? findCandidateAVX2<Count>(data, size, filter, pos)
+                                      : findCandidateSSE2<Count>(data, size, filter, pos);
+    }
+
+    bool cpuHasSSE2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+
+    bool cpuHasAVX2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX2 also needs the OS to save YMM registers
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx     = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    std::unique_ptr<zip_t, jhunter::io::ZipDeleter> openZip(const std::string& zipPath)
+    {
+        int error = 0;
+        std::unique_ptr<zip_t, jhunter::io::ZipDeleter> handle(zip_open(zipPath.c_str(), ZIP_RDONLY, &error));
+        if (!handle)
+        {
+            std::cerr << "Error opening zip file: " << zipPath << " (Error code: " << error << ")" << std::endl;
+            throw std::runtime_error("Failed to open zip file.");
+        }
+        return handle;
+    }
+
+    jhunter::io::Buffer readZipEntry(zip_t* zipHandle, zip_uint64_t index, std::pmr::memory_resource* resource)
+    {
+        jhunter::stats::ScopedTimer timer(jhunter::stats::Counter::InflateNanos);
+
+        struct zip_stat st;
+        zip_stat_init(&st);
+        if (zip_stat_index(zipHandle, index, 0, &st) != 0)
+        {
+            std::cerr << "Error getting file stat of entry: " << index << std::endl;
+            throw std::runtime_error("Failed to get file stat.");
+        }
+
+        std::unique_ptr<zip_file_t, jhunter::io::ZipFileDeleter> file(zip_fopen_index(zipHandle, index, 0));
+        if (!file)
+        {
+            std::cerr << "Error opening entry: " << (st.name ? st.name : std::to_string(index)) << std::endl;
+            throw std::runtime_error("Failed to open file.");
+        }
+
+        jhunter::io::Buffer buffer(st.size, resource);
+        if (zip_fread(file.get(), buffer.data(), buffer.size()) != static_cast<zip_int64_t>(buffer.size()))
+        {
+            std::cerr << "Error reading entry: " << (st.name ? st.name : std::to_string(index)) << std::endl;
+            throw std::runtime_error("Failed to read file.");
+        }
+
+        jhunter::stats::add(jhunter::stats::Counter::EntriesInflated, 1);
+        jhunter::stats::add(jhunter::stats::Counter::BytesInflated, buffer.size());
+        return buffer;
+    }
+
+    // Where the data of a STORED entry lies in a mapped zip
+    struct StoredEntry
+    {
+        bool     stored = false; // Unencrypted, STORED and with a valid local header
+        uint64_t offset = 0;
+        uint64_t size   = 0;
+        uint32_t crc    = 0;
+    };
+
+    uint64_t loadIntLE(const unsigned char* data, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        return value;
+    }
+
+    // Walk the central directory of a zip in memory, one record per entry in the order libzip indexes them. Returns
+    // nothing if the directory can not be parsed, the archive is then read through libzip only
+    std::vector<StoredEntry> locateStoredEntries(const char* mapped, size_t size)
+    {
+        const auto* data = reinterpret_cast<const unsigned char*>(mapped);
+        constexpr size_t EOCD_SIZE = 22;
+        if (size < EOCD_SIZE)
+            return {};
+
+        // The end of central directory record is followed by a comment of at most 64 KiB
+        size_t eocd = size - EOCD_SIZE;
+        size_t last = size > EOCD_SIZE + 0xFFFF ? size - EOCD_SIZE - 0xFFFF : 0;
+        while (loadIntLE(data + eocd, 4) != 0x06054b50)
+        {
+            if (eocd == last)
+                return {};
+            --eocd;
+        }
+
+        uint64_t entryCount = loadIntLE(data + eocd + 10, 2);
+        uint64_t dirOffset  = loadIntLE(data + eocd + 16, 4);
+
+        // Zip64 keeps the real values in a record of its own, found through a locator right before
+        if ((entryCount == 0xFFFF || dirOffset == 0xFFFFFFFF) && eocd >= 20 &&
+            loadIntLE(data + eocd - 20, 4) == 0x07064b50)
+        {
+            uint64_t record = loadIntLE(data + eocd - 20 + 8, 8);
+            if (size < 56 || record > size - 56 || loadIntLE(data + record, 4) != 0x06064b50)
+                return {};
+            entryCount = loadIntLE(data + record + 32, 8);
+            dirOffset  = loadIntLE(data + record + 48, 8);
+        }
+
+        // Every record takes at least 46 bytes, which also bounds the reserve below
+        if (dirOffset > size || entryCount > (size - dirOffset) / 46)
+            return {};
+
+        std::vector<StoredEntry> entries;
+        entries.reserve(entryCount);
+        uint64_t pos = dirOffset;
+        for (uint64_t i = 0; i < entryCount; ++i)
+        {
+            if (pos + 46 > size || loadIntLE(data + pos, 4) != 0x02014b50)
+                return {};
+
+            uint64_t flags         = loadIntLE(data + pos + 8, 2);
+            uint64_t method        = loadIntLE(data + pos + 10, 2);
+            uint64_t compressed    = loadIntLE(data + pos + 20, 4);
+            uint64_t uncompressed  = loadIntLE(data + pos + 24, 4);
+            uint64_t nameLength    = loadIntLE(data + pos + 28, 2);
+            uint64_t extraLength   = loadIntLE(data + pos + 30, 2);
+            uint64_t commentLength = loadIntLE(data + pos + 32, 2);
+            uint64_t localOffset   = loadIntLE(data + pos + 42, 4);
+
+            StoredEntry entry;
+            entry.crc = static_cast<uint32_t>(loadIntLE(data + pos + 16, 4));
+
+            uint64_t next = pos + 46 + nameLength + extraLength + commentLength;
+            if (next > size)
+                return {};
+
+            // Zip64 extra field: only the values saturated in the record are in it, in this order
+            uint64_t extra    = pos + 46 + nameLength;
+            uint64_t extraEnd = extra + extraLength;
+            while (extra + 4 <= extraEnd)
+            {
+                uint64_t id     = loadIntLE(data + extra, 2);
+                uint64_t length = loadIntLE(data + extra + 2, 2);
+                uint64_t field  = extra + 4;
+                uint64_t end    = std::min(field + length, extraEnd);
+                if (id == 0x0001)
+                {
+                    for (uint64_t* value : {&uncompressed, &compressed, &localOffset})
+                    {
+                        if (*value != 0xFFFFFFFF)
+                            continue;
+                        if (field + 8 > end)
+                            break;
+                        *value = loadIntLE(data + field, 8);
+                        field += 8;
+                    }
+                }
+                extra = end;
+            }
+
+            // Encrypted entries are left to libzip. A zip64 offset can be any 64-bit value, so no sums before the
+            // header is known to fit
+            if (method == 0 && (flags & 0x1) == 0 && compressed == uncompressed && size >= 30 &&
+                localOffset <= size - 30 && loadIntLE(data + localOffset, 4) == 0x04034b50)
+            {
+                uint64_t start = localOffset + 30 + loadIntLE(data + localOffset + 26, 2) +
+                                 loadIntLE(data + localOffset + 28, 2);
+                if (start <= size && uncompressed <= size - start)
+                {
+                    entry.stored = true;
+                    entry.offset = start;
+                    entry.size   = uncompressed;
+                }
+            }
+
+            entries.push_back(entry);
+            pos = next;
+        }
+        return entries;
+    }
+
+    // A zlib inflate state reused for every trial at a possible stream start, a reset costs far less than an init
+    class StreamInflater
+    {
+    public:
+        enum class Result
+        {
+            Complete, // A whole stream that passed its checksum, if it has one
+            Invalid,  // Not a stream after all, or one cut short
+            TooLarge, // A whole stream, but of more than maxOutput bytes. Only consumed is set
+            OutOfTime // The deadline passed
+        };
+
+        // windowBits as for inflateInit2: 15 for zlib, 31 for gzip, -15 for raw deflate
+        explicit StreamInflater(int windowBits) : m_WindowBits(windowBits) {}
+
+        ~StreamInflater()
+        {
+            if (m_Initialized)
+                inflateEnd(&m_Stream);
+        }
+
+        StreamInflater(const StreamInflater&)            = delete;
+        StreamInflater& operator=(const StreamInflater&) = delete;
+
+        // Inflate the stream starting at data into output, keeping at most maxOutput bytes. On Complete and
+        // TooLarge, consumed is the number of input bytes the stream took
+        Result inflate(const unsigned char*                  data,
+                       size_t                                size,
+                       size_t                                maxOutput,
+                       std::chrono::steady_clock::time_point deadline,
+                       jhunter::io::Buffer&                  output,
+                       size_t&                               consumed)
+        {
+            if (!m_Initialized)
+            {
+                if (inflateInit2(&m_Stream, m_WindowBits) != Z_OK)
+                {
+                    std::cerr << "Error: Failed to initialize zlib." << std::endl;
+                    throw std::runtime_error("Failed to initialize zlib.");
+                }
+                m_Initialized = true;
+            }
+            else
+            {
+                inflateReset(&m_Stream);
+            }
+
+            m_Stream.next_in  = const_cast<Bytef*>(data);
+            m_Stream.avail_in = static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+
+            // Most trials fail within a few bytes, so the output starts small and doubles
+            output.clear();
+            bool discarding = false;
+            while (true)
+            {
+                if (discarding)
+                {
+                    m_Stream.next_out  = m_Discard.data();
+                    m_Stream.avail_out = static_cast<uInt>(m_Discard.size());
+                }
+                else
+                {
+                    size_t offset = output.size();
+                    size_t chunk  = std::min(std::max<size_t>(offset, 256), maxOutput - offset + 1);
+                    output.resize(offset + chunk);
+                    m_Stream.next_out  = reinterpret_cast<Bytef*>(output.data() + offset);
+                    m_Stream.avail_out = static_cast<uInt>(chunk);
+                }
+
+                int result = ::inflate(&m_Stream, Z_NO_FLUSH);
+                if (!discarding)
+                    output.resize(output.size() - m_Stream.avail_out);
+                if (result == Z_STREAM_END)
+                {
+                    consumed = m_Stream.total_in;
+                    return !discarding && output.size() <= maxOutput ? Result::Complete : Result::TooLarge;
+                }
+                if (result != Z_OK)
+                    return Result::Invalid;
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return Result::OutOfTime;
+
+                // Past the budget the rest is inflated into scratch space and dropped, only to find where it ends
+                if (!discarding && output.size() > maxOutput)
+                {
+                    discarding = true;
+                    output.clear();
+                    m_Discard.resize(64 * 1024);
+                }
+            }
+        }
+
+    private:
+        int                        m_WindowBits;
+        bool                       m_Initialized = false;
+        z_stream                   m_Stream {};
+        std::vector<unsigned char> m_Discard; // Output of a stream over the budget
+    };
+
+    // Finds and inflates the streams of one entry, recursing into their output. The budgets are shared by all depths
+    class EmbeddedStreamScan
+    {
+    public:
+        EmbeddedStreamScan(const jhunter::io::EmbeddedStreamSettings& settings, std::pmr::memory_resource* resource) :
+            m_Settings(settings), m_Resource(resource),
+            m_Deadline(std::chrono::steady_clock::now() + settings.timeBudget), m_OutputLeft(settings.maxOutputBytes)
+        {}
+
+        // Streams found in buffer and in their output, each container before the streams inside it
+        std::vector<jhunter::io::Buffer> run(jhunter::io::ByteSpan buffer)
+        {
+            if (m_Settings.maxDepth > 0)
+                scan(buffer, 1);
+            return std::move(m_Results);
+        }
+
+    private:
+        // CMF and FLG of a zlib header: deflate with a window of at most 32 KiB, no preset dictionary, the check
+        // bits right, and a valid first block type
+        static bool isZlibHeader(const unsigned char* p, size_t left)
+        {
+            return left >= 3 && (p[0] & 0x0F) == 8 && (p[0] >> 4) <= 7 && ((p[0] << 8) | p[1]) % 31 == 0 &&
+                   (p[1] & 0x20) == 0 && ((p[2] >> 1) & 3) != 3;
+        }
+
+        // Magic, deflate and no reserved flags
+        static bool isGzipHeader(const unsigned char* p, size_t left)
+        {
+            return left >= 10 && p[0] == 0x1F && p[1] == 0x8B && p[2] == 8 && (p[3] & 0xE0) == 0;
+        }
+
+        // A deflate block header. Stored blocks are checked by their length and its complement
+        static bool isDeflateBlock(const unsigned char* p, size_t left)
+        {
+            unsigned type = (p[0] >> 1) & 3;
+            if (type == 3)
+                return false;
+            if (type != 0)
+                return true;
+            return left >= 5 && (p[1] | (p[2] << 8)) == (~(p[3] | (p[4] << 8)) & 0xFFFF);
+        }
+
+        // Data of a PNG IDAT chunk starting at pos, its length if so. Image data is not worth inflating
+        static size_t idatLength(const unsigned char* bytes, size_t pos)
+        {
+            if (pos < 8 || std::memcmp(bytes + pos - 4, "IDAT", 4) != 0)
+                return 0;
+            const unsigned char* length = bytes + pos - 8;
+            return (size_t(length[0]) << 24) | (size_t(length[1]) << 16) | (size_t(length[2]) << 8) | length[3];
+        }
+
+        void scan(jhunter::io::ByteSpan buffer, size_t depth)
+        {
+            const auto*         bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+            const size_t        size  = buffer.size();
+
+            // Trials grow their output by doubling. That happens on the heap, as a monotonic resource like the arena
+            // would keep every outgrown buffer, and only accepted streams are copied into the resource
+            jhunter::io::Buffer output(std::pmr::new_delete_resource());
+
+            size_t pos = 0;
+            while (pos + 2 < size)
+            {
+                // The clock is read every few KiB, trials in between are short
+                if ((pos & 0xFFF) == 0 && std::chrono::steady_clock::now() >= m_Deadline)
+                    return;
+
+                StreamInflater* inflater = nullptr;
+                if (isZlibHeader(bytes + pos, size - pos))
+                {
+                    if (size_t skip = idatLength(bytes, pos))
+                    {
+                        pos += skip;
+                        continue;
+                    }
+                    inflater = &m_Zlib;
+                }
+                else if (isGzipHeader(bytes + pos, size - pos))
+                {
+                    inflater = &m_Gzip;
+                }
+                else if (m_Settings.rawDeflate && isDeflateBlock(bytes + pos, size - pos))
+                {
+                    inflater = &m_Raw;
+                }
+
+                if (inflater == nullptr)
+                {
+                    ++pos;
+                    continue;
+                }
+
+                // Nothing worth keeping fits anymore
+                if (m_OutputLeft < m_Settings.minOutputSize)
+                    return;
+
+                size_t consumed = 0;
+                auto   result   = inflater->inflate(bytes + pos, size - pos, m_OutputLeft, m_Deadline, output, consumed);
+                if (result == StreamInflater::Result::OutOfTime)
+                {
+                    m_Deadline = std::chrono::steady_clock::now(); // The scans of the outer streams stop as well
+                    return;
+                }
+                if (result == StreamInflater::Result::TooLarge)
+                {
+                    // Does not fit what is left of the budget, smaller streams after it still may
+                    pos += std::max<size_t>(consumed, 1);
+                    continue;
+                }
+                if (result == StreamInflater::Result::Invalid || consumed == 0)
+                {
+                    ++pos;
+                    continue;
+                }
+
+                pos += consumed;
+                if (output.size() < m_Settings.minOutputSize)
+                    continue;
+
+                m_OutputLeft -= output.size();
+                jhunter::stats::add(jhunter::stats::Counter::EmbeddedStreams, 1);
+                jhunter::stats::add(jhunter::stats::Counter::BytesEmbedded, output.size());
+
+                // The slot is taken first so nested streams come after their container. The output is scanned
+                // before it moves in, m_Results may grow meanwhile. The stream shares the resource of the slot, so
+                // the move never copies
+                size_t index = m_Results.size();
+                m_Results.emplace_back(m_Resource);
+                jhunter::io::Buffer stream(output.begin(), output.end(), m_Resource);
+                output.clear();
+                if (depth < m_Settings.maxDepth)
+                    scan(stream, depth + 1);
+                m_Results[index] = std::move(stream);
+            }
+        }
+
+        const jhunter::io::EmbeddedStreamSettings& m_Settings;
+        std::pmr::memory_resource*                m_Resource;
+        std::chrono::steady_clock::time_point     m_Deadline;
+        size_t                                    m_OutputLeft;
+
+        StreamInflater m_Zlib {15};
+        StreamInflater m_Gzip {31};
+        StreamInflater m_Raw {-15};
+
+        std::vector<jhunter::io::Buffer> m_Results;
+    };
+
+    // CRC-32 as used by PNG and zip, reflected polynomial 0xEDB88320. The functions below work on the inverted
+    // checksum, crc32Update inverts before and after
+
+    using Crc32Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+    // Table k advances a CRC by a byte followed by k zero bytes, which lets slice-by-8 look up 8 bytes at once
+    const Crc32Tables& getCrc32Tables()
+    {
+        static const auto tables = [] {
+            Crc32Tables entries {};
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                entries[0][n] = c;
+            }
+            for (size_t k = 1; k < entries.size(); ++k)
+            {
+                for (uint32_t n = 0; n < 256; ++n)
+                    entries[k][n] = (entries[k - 1][n] >> 8) ^ entries[0][entries[k - 1][n] & 0xFF];
+            }
+            return entries;
+        }();
+        return tables;
+    }
+
+    uint32_t crc32SliceBy8(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        const auto& t = getCrc32Tables();
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            uint32_t low  = crc ^ (uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) |
+                                  (uint32_t(data[3]) << 24));
+            uint32_t high = uint32_t(data[4]) | (uint32_t(data[5]) << 8) | (uint32_t(data[6]) << 16) |
+                            (uint32_t(data[7]) << 24);
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                  t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        }
+        for (; size > 0; ++data, --size)
+            crc = t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+        return crc;
+    }
+
+#ifdef JHUNTER_X86
+    bool cpuHasPCLMUL()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 1)) != 0 && (info[2] & (1 << 19)) != 0; // PCLMULQDQ and SSE4.1
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+    }
+
+    JHUNTER_TARGET_PCLMUL inline __m128i loadCrcBlock(const unsigned char* data)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    }
+
+    // Fold a 128-bit lane over the distance k stands for and add the next block
+    JHUNTER_TARGET_PCLMUL inline __m128i foldCrcLane(__m128i lane, __m128i k, __m128i next)
+    {
+        __m128i low  = _mm_clmulepi64_si128(lane, k, 0x00);
+        __m128i high = _mm_clmulepi64_si128(lane, k, 0x11);
+        return _mm_xor_si128(_mm_xor_si128(high, low), next);
+    }
+
+    // Carry-less multiplication folding after Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ".
+    // Four 128-bit lanes are folded 64 bytes ahead at a time, then into one lane and reduced with Barrett.
+    // size must be a multiple of 16 and at least 64
+    JHUNTER_TARGET_PCLMUL uint32_t crc32PCLMUL(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596}; // Folding 512 bits ahead
+        alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e}; // Folding 128 bits ahead
+        alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000}; // Folding 64 bits ahead
+        alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641}; // P(x) and its Barrett constant
+
+        __m128i x1 = _mm_xor_si128(loadCrcBlock(data), _mm_cvtsi32_si128(static_cast<int>(crc)));
+        __m128i x2 = loadCrcBlock(data + 16);
+        __m128i x3 = loadCrcBlock(data + 32);
+        __m128i x4 = loadCrcBlock(data + 48);
+        data += 64;
+        size -= 64;
+
+        __m128i k = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+        for (; size >= 64; data += 64, size -= 64)
+        {
+            x1 = foldCrcLane(x1, k, loadCrcBlock(data));
+            x2 = foldCrcLane(x2, k, loadCrcBlock(data + 16));
+            x3 = foldCrcLane(x3, k, loadCrcBlock(data + 32));
+            x4 = foldCrcLane(x4, k, loadCrcBlock(data + 48));
+        }
+
+        k  = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+        x1 = foldCrcLane(x1, k, x2);
+        x1 = foldCrcLane(x1, k, x3);
+        x1 = foldCrcLane(x1, k, x4);
+        for (; size >= 16; data += 16, size -= 16)
+            x1 = foldCrcLane(x1, k, loadCrcBlock(data));
+
+        // 128 bits down to 64
+        const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x2                   = _mm_clmulepi64_si128(x1, k, 0x10);
+        x1                   = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        k                    = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+        x2                   = _mm_srli_si128(x1, 4);
+        x1                   = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00), x2);
+
+        // Barrett reduction to 32 bits
+        k  = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+#endif
+
+#ifdef JHUNTER_ARM_CRC
+    bool cpuHasArmCRC()
+    {
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+        return true;
+#elif defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+        return false;
+#endif
+    }
+
+    // The ARMv8 CRC32 instructions use the zip polynomial, 8 bytes per instruction
+    JHUNTER_TARGET_ARM_CRC uint32_t crc32Arm(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        for (; size >= 8; data += 8, size -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc = __crc32d(crc, word);
+        }
+        for (; size > 0; ++data, --size)
+            crc = __crc32b(crc, *data);
+        return crc;
+    }
+#endif
+
+    enum class Crc32Kernel
+    {
+        SliceBy8,
+        PCLMUL,
+        ArmCRC
+    };
+
+    Crc32Kernel detectCrc32Kernel()
+    {
+        static const Crc32Kernel kernel = [] {
+#ifdef JHUNTER_X86
+            if (cpuHasPCLMUL())
+                return Crc32Kernel::PCLMUL;
+#endif
+#ifdef JHUNTER_ARM_CRC
+            if (cpuHasArmCRC())
+                return Crc32Kernel::ArmCRC;
+#endif
+            return Crc32Kernel::SliceBy8;
+        }();
+        return kernel;
+    }
+
+    // Call with crc = 0 to start a new checksum
+    uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        crc = ~crc;
+        switch (detectCrc32Kernel())
+        {
+#ifdef JHUNTER_X86
+            case Crc32Kernel::PCLMUL:
+                // Folding pays off from a few cache lines on, the tail is left to the tables
+                if (size >= 64)
+                {
+                    size_t folded = size & ~size_t(15);
+                    crc           = crc32PCLMUL(crc, data, folded);
+                    data += folded;
+                    size -= folded;
+                }
+                break;
+#endif
+#ifdef JHUNTER_ARM_CRC
+            case Crc32Kernel::ArmCRC:
+                return ~crc32Arm(crc, data, size);
+#endif
+            default:
+                break;
+        }
+        return ~crc32SliceBy8(crc, data, size);
+    }
+
+    // Streaming XXH64, a fast non-cryptographic 64-bit hash used to spot identical assets
+    class Xxh64
+    {
+    public:
+        explicit Xxh64(uint64_t seed = 0) :
+            m_Lanes {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1}, m_Seed(seed)
+        {}
+
+        void update(const unsigned char* data, size_t size)
+        {
+            m_TotalSize += size;
+
+            // Complete a stripe left over from the previous update first
+            if (m_StripeSize > 0)
+            {
+                size_t take = std::min(size, m_Stripe.size() - m_StripeSize);
+                std::memcpy(m_Stripe.data() + m_StripeSize, data, take);
+                m_StripeSize += take;
+                data += take;
+                size -= take;
+                if (m_StripeSize < m_Stripe.size())
+                    return;
+                consumeStripe(m_Stripe.data());
+                m_StripeSize = 0;
+            }
+
+            for (; size >= m_Stripe.size(); data += m_Stripe.size(), size -= m_Stripe.size())
+                consumeStripe(data);
+
+            std::memcpy(m_Stripe.data(), data, size);
+            m_StripeSize = size;
+        }
+
+        uint64_t digest() const
+        {
+            uint64_t hash;
+            if (m_TotalSize >= m_Stripe.size())
+            {
+                hash = std::rotl(m_Lanes[0], 1) + std::rotl(m_Lanes[1], 7) + std::rotl(m_Lanes[2], 12) +
+                       std::rotl(m_Lanes[3], 18);
+                for (uint64_t lane : m_Lanes)
+                    hash = (hash ^ round(0, lane)) * PRIME1 + PRIME4;
+            }
+            else
+            {
+                hash = m_Seed + PRIME5;
+            }
+            hash += m_TotalSize;
+
+            // Fold in the tail that did not fill a stripe
+            const unsigned char* tail = m_Stripe.data();
+            size_t               size = m_StripeSize;
+            for (; size >= 8; tail += 8, size -= 8)
+                hash = std::rotl(hash ^ round(0, readLE<uint64_t>(tail)), 27) * PRIME1 + PRIME4;
+            if (size >= 4)
+            {
+                hash = std::rotl(hash ^ (readLE<uint32_t>(tail) * PRIME1), 23) * PRIME2 + PRIME3;
+                tail += 4;
+                size -= 4;
+            }
+            for (; size > 0; ++tail, --size)
+                hash = std::rotl(hash ^ (*tail * PRIME5), 11) * PRIME1;
+
+            // Avalanche
+            hash ^= hash >> 33;
+            hash *= PRIME2;
+            hash ^= hash >> 29;
+            hash *= PRIME3;
+            hash ^= hash >> 32;
+            return hash;
+        }
+
+    private:
+        static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+        static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+        static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+        static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+        static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+        template<typename T>
+        static T readLE(const unsigned char* bytes)
+        {
+            T value = 0;
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                std::memcpy(&value, bytes, sizeof(T));
+            }
+            else
+            {
+                for (size_t i = 0; i < sizeof(T); ++i)
+                    value |= static_cast<T>(bytes[i]) << (8 * i);
+            }
+            return value;
+        }
+
+        static uint64_t round(uint64_t lane, uint64_t input) { return std::rotl(lane + input * PRIME2, 31) * PRIME1; }
+
+        void consumeStripe(const unsigned char* stripe)
+        {
+            for (size_t lane = 0; lane < 4; ++lane)
+                m_Lanes[lane] = round(m_Lanes[lane], readLE<uint64_t>(stripe + lane * 8));
+        }
+
+    private:
+        std::array<uint64_t, 4>       m_Lanes;
+        std::array<unsigned char, 32> m_Stripe {};
+        size_t                        m_StripeSize = 0;
+        uint64_t                      m_TotalSize  = 0;
+        uint64_t                      m_Seed;
+    };
+
+    // Wrap carved data into a file record, hashing it while it is still in cache
+    template<typename File>
+    File makeCarvedFile(jhunter::hunter::CarvedData&& data)
+    {
+        File file {std::move(data)};
+        file.contentHash = file.data.contentHash();
+        return file;
+    }
+
+    // Cache file layout: magic, settings key, jar count, then every jar record. Integers are little-endian,
+    // strings are a 32-bit length followed by the bytes
+    constexpr std::string_view CACHE_MAGIC = "JHCACHE1";
+
+    // Little-endian integer of the given byte count, as used by the cache and zip formats
+    void writeIntLE(std::ostream& stream, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; ++i)
+            stream.put(static_cast<char>(value >> (8 * i)));
+    }
+
+    void writeCacheString(std::ostream& stream, const std::string& value)
+    {
+        writeIntLE(stream, value.size(), 4);
+        stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    uint64_t readIntLE(std::istream& stream, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i)
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(stream.get())) << (8 * i);
+        if (!stream)
+            throw std::runtime_error("Truncated file.");
+        return value;
+    }
+
+    std::string readCacheString(std::istream& stream)
+    {
+        // Paths are short, a huge length means the file is corrupt
+        uint64_t size = readIntLE(stream, 4);
+        if (size > 64 * 1024)
+            throw std::runtime_error("Corrupt file.");
+
+        std::string value(size, '\0');
+        stream.read(value.data(), static_cast<std::streamsize>(size));
+        if (!stream)
+            throw std::runtime_error("Truncated file.");
+        return value;
+    }
+
+    // Manifest file layout: magic, jar path, fingerprint, the names of the entries holding assets as index and name,
+    // then every record. Integers and strings as in the cache file
+    constexpr std::string_view MANIFEST_MAGIC = "JHMANIF1";
+
+    // The first bytes of a carved asset, zero-filled past its end. Enough for the PNG IHDR and the MIDI header
+    std::array<unsigned char, 24> readAssetHead(const jhunter::hunter::CarvedData& data)
+    {
+        std::array<unsigned char, 24> head {};
+        size_t                        filled = 0;
+        for (const auto& segment : data.getSegments())
+        {
+            size_t count = std::min(segment.size, head.size() - filled);
+            std::memcpy(head.data() + filled, segment.data(), count);
+            if ((filled += count) == head.size())
+                break;
+        }
+        return head;
+    }
+
+    // A 64-bit hash as 16 hex digits, JSON numbers can not hold all of it
+    std::string toHex(uint64_t value)
+    {
+        std::ostringstream text;
+        text << std::hex << std::setw(16) << std::setfill('0') << value;
+        return text.str();
+    }
+
+    void ensureOutputDirectory(const std::string& outputDir)
+    {
+        std::filesystem::path dir(outputDir);
+        if (!std::filesystem::exists(dir))
+        {
+            if (!std::filesystem::create_directories(dir))
+            {
+                std::cerr << "Error: Failed to create output directory: " << outputDir << std::endl;
+                throw std::runtime_error("Failed to create output directory.");
+            }
+        }
+    }
+
+    // Largest magnitude among samples, a loop the compiler vectorizes
+    int peakLevel(const int16_t* samples, size_t count)
+    {
+        int peak = 0;
+        for (size_t i = 0; i < count; ++i)
+            peak = std::max(peak, std::abs(static_cast<int>(samples[i])));
+        return peak;
+    }
+
+    // The same for float samples, in 16-bit steps
+    int peakLevel(const float* samples, size_t count)
+    {
+        float peak = 0;
+        for (size_t i = 0; i < count; ++i)
+            peak = std::max(peak, std::abs(samples[i]));
+        return static_cast<int>(std::min(peak, 1.0f) * 32767.0f);
+    }
+
+    // Triangular dither in 16-bit steps, read in order and wrapped around at DITHER_SIZE. The tail repeats the head,
+    // so up to DITHER_TAIL values can be read from any position before the wrap
+    constexpr size_t DITHER_SIZE = 16384;
+    constexpr size_t DITHER_TAIL = 4096;
+
+    const float* getDitherTable()
+    {
+        static const std::vector<float> table = [] {
+            std::vector<float> values(DITHER_SIZE + DITHER_TAIL);
+            uint32_t           state = 0x9E3779B9; // Fixed, so the same MIDI always renders to the same WAV
+            auto               next  = [&state] {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+            };
+            for (size_t i = 0; i < DITHER_SIZE; ++i)
+            {
+                float first = next();
+                values[i]   = first - next();
+            }
+            std::copy_n(values.begin(), DITHER_TAIL, values.begin() + DITHER_SIZE);
+            return values;
+        }();
+        return table.data();
+    }
+
+    // Planar float samples of FluidSynth to interleaved 16-bit PCM, or mixed down when channels is 1. Every output
+    // sample is scaled, gets its dither value added when dither is set, is saturated and rounded to nearest. The SIMD
+    // kernels below do the same steps in the same order, so all of them give the same WAV
+    void convertToS16Scalar(const float* left,
+                            const float* right,
+                            size_t       frames,
+                            int          channels,
+                            const float* dither,
+                            int16_t*     out)
+    {
+        auto convert = [](float sample, float noise) {
+            float scaled = sample * 32767.0f + noise;
+            scaled       = scaled > -32768.0f ? scaled : -32768.0f; // Like maxps, NaN saturates low
+            scaled       = scaled < 32767.0f ? scaled : 32767.0f;
+            return static_cast<int16_t>(std::lrintf(scaled));
+        };
+
+        if (channels == 1)
+        {
+            for (size_t i = 0; i < frames; ++i)
+                out[i] = convert((left[i] + right[i]) * 0.5f, dither ? dither[i] : 0.0f);
+            return;
+        }
+
+        for (size_t i = 0; i < frames; ++i)
+        {
+            out[2 * i]     = convert(left[i], dither ? dither[2 * i] : 0.0f);
+            out[2 * i + 1] = convert(right[i], dither ? dither[2 * i + 1] : 0.0f);
+        }
+    }
+
+#ifdef JHUNTER_X86
+    JHUNTER_TARGET_SSE2 void convertToS16SSE2(const float* left,
+                                              const float* right,
+                                              size_t       frames,
+                                              int          channels,
+                                              const float* dither,
+                                              int16_t*     out)
+    {
+        const __m128 scale = _mm_set1_ps(32767.0f);
+        const __m128 low   = _mm_set1_ps(-32768.0f);
+        const __m128 high  = _mm_set1_ps(32767.0f);
+        auto noiseAt       = [dither](size_t sample) JHUNTER_TARGET_SSE2 {
+            return dither ? _mm_loadu_ps(dither + sample) : _mm_setzero_ps();
+        };
+        auto convert = [&](__m128 samples, __m128 noise) JHUNTER_TARGET_SSE2 {
+            __m128 scaled = _mm_add_ps(_mm_mul_ps(samples, scale), noise);
+            return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(scaled, low), high));
+        };
+
+        size_t i = 0;
+        if (channels == 1)
+        {
+            const __m128 half = _mm_set1_ps(0.5f);
+            for (; i + 8 <= frames; i += 8)
+            {
+                __m128 first  = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(left + i), _mm_loadu_ps(right + i)), half);
+                __m128 second = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(left + i + 4), _mm_loadu_ps(right + i + 4)), half);
+                __m128i packed = _mm_packs_epi32(convert(first, noiseAt(i)), convert(second, noiseAt(i + 4)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+            }
+        }
+        else
+        {
+            for (; i + 4 <= frames; i += 4)
+            {
+                __m128  l      = _mm_loadu_ps(left + i);
+                __m128  r      = _mm_loadu_ps(right + i);
+                __m128i first  = convert(_mm_unpacklo_ps(l, r), noiseAt(2 * i));     // L0 R0 L1 R1
+                __m128i second = convert(_mm_unpackhi_ps(l, r), noiseAt(2 * i + 4)); // L2 R2 L3 R3
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_packs_epi32(first, second));
+            }
+        }
+
+        convertToS16Scalar(left + i, right + i, frames - i, channels, dither ? dither + i * channels : nullptr,
+                           out + i * channels);
+    }
+
+    JHUNTER_TARGET_AVX2 void convertToS16AVX2(const float* left,
+                                              const float* right,
+                                              size_t       frames,
+                                              int          channels,
+                                              const float* dither,
+                                              int16_t*     out)
+    {
+        const __m256 scale = _mm256_set1_ps(32767.0f);
+        const __m256 low   = _mm256_set1_ps(-32768.0f);
+        const __m256 high  = _mm256_set1_ps(32767.0f);
+        auto noiseAt       = [dither](size_t sample) JHUNTER_TARGET_AVX2 {
+            return dither ? _mm256_loadu_ps(dither + sample) : _mm256_setzero_ps();
+        };
+        auto convert = [&](__m256 samples, __m256 noise) JHUNTER_TARGET_AVX2 {
+            __m256 scaled = _mm256_add_ps(_mm256_mul_ps(samples, scale), noise);
+            return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, low), high));
+        };
+
+        size_t i = 0;
+        if (channels == 1)
+        {
+            const __m256 half = _mm256_set1_ps(0.5f);
+            for (; i + 16 <= frames; i += 16)
+            {
+                __m256 first =
+                    _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(left + i), _mm256_loadu_ps(right + i)), half);
+                __m256 second =
+                    _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(left + i + 8), _mm256_loadu_ps(right + i + 8)), half);
+
+                // Packing works per 128-bit lane, which leaves the quarters as 0 2 1 3
+                __m256i packed = _mm256_packs_epi32(convert(first, noiseAt(i)), convert(second, noiseAt(i + 8)));
+                packed         = _mm256_permute4x64_epi64(packed, 0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+            }
+        }
+        else
+        {
+            for (; i + 8 <= frames; i += 8)
+            {
+                // Unpacking works per 128-bit lane as well: the first half gets frames 0-1 and 4-5, the second half
+                // frames 2-3 and 6-7, which packing puts back in order. The dither is picked to match
+                __m256  l       = _mm256_loadu_ps(left + i);
+                __m256  r       = _mm256_loadu_ps(right + i);
+                __m256  noise0  = noiseAt(2 * i);
+                __m256  noise1  = noiseAt(2 * i + 8);
+                __m256i first   = convert(_mm256_unpacklo_ps(l, r), _mm256_permute2f128_ps(noise0, noise1, 0x20));
+                __m256i second  = convert(_mm256_unpackhi_ps(l, r), _mm256_permute2f128_ps(noise0, noise1, 0x31));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i), _mm256_packs_epi32(first, second));
+            }
+        }
+
+        convertToS16Scalar(left + i, right + i, frames - i, channels, dither ? dither + i * channels : nullptr,
+                           out + i * channels);
+    }
+#endif
+
+    using SampleConverter = void (*)(const float*, const float*, size_t, int, const float*, int16_t*);
+
+    SampleConverter getSampleConverter()
+    {
+        static const SampleConverter converter = []() -> SampleConverter {
+#ifdef JHUNTER_X86
+            if (cpuHasAVX2())
+                return &convertToS16AVX2;
+            if (cpuHasSSE2())
+                return &convertToS16SSE2;
+#endif
+            return &convertToS16Scalar;
+        }();
+        return converter;
+    }
+
+    // Planar float samples of FluidSynth to interleaved float samples, or mixed down when channels is 1
+    void interleaveFloat(const float* left, const float* right, size_t frames, int channels, float* out)
+    {
+        if (channels == 1)
+        {
+            for (size_t i = 0; i < frames; ++i)
+                out[i] = (left[i] + right[i]) * 0.5f;
+            return;
+        }
+
+        for (size_t i = 0; i < frames; ++i)
+        {
+            out[2 * i]     = left[i];
+            out[2 * i + 1] = right[i];
+        }
+    }
+
+    // Builds a WAV of 16-bit PCM or 32-bit float samples in memory. Interleaved frames are rendered straight into the
+    // output, the header gets the final sizes on finish
+    class WavWriter
+    {
+    public:
+        WavWriter(jhunter::io::Buffer& output,
+                  int                 sampleRate,
+                  int                 numChannels,
+                  int                 bitsPerSample,
+                  size_t              reserveFrames) :
+            m_Output(output), m_SampleRate(sampleRate), m_NumChannels(numChannels), m_BitsPerSample(bitsPerSample)
+        {
+            // The header is filled in by finish
+            m_Output.clear();
+            m_Output.reserve(HEADER_SIZE + reserveFrames * getFrameSize());
+            m_Output.resize(HEADER_SIZE);
+        }
+
+        // Room for frameCount interleaved frames, counted as written. Valid until the next call. Sample is int16_t
+        // for 16 bits and float for 32
+        template<typename Sample>
+        Sample* nextFrames(size_t frameCount)
+        {
+            size_t offset = m_Output.size();
+            m_Output.resize(offset + frameCount * getFrameSize());
+            m_FrameCount += frameCount;
+            return reinterpret_cast<Sample*>(m_Output.data() + offset);
+        }
+
+        uint64_t getFrameCount() const { return m_FrameCount; }
+
+        // Fade the last frameCount frames out linearly, so a render cut short ends without a click
+        template<typename Sample>
+        void fadeOut(uint64_t frameCount)
+        {
+            frameCount      = std::min(frameCount, m_FrameCount);
+            Sample* samples = reinterpret_cast<Sample*>(m_Output.data() + m_Output.size());
+            samples -= frameCount * m_NumChannels;
+            for (uint64_t frame = 0; frame < frameCount; ++frame)
+            {
+                float gain = static_cast<float>(frameCount - frame) / static_cast<float>(frameCount);
+                for (int channel = 0; channel < m_NumChannels; ++channel, ++samples)
+                    *samples = static_cast<Sample>(*samples * gain);
+            }
+        }
+
+        void finish()
+        {
+            if constexpr (std::endian::native == std::endian::big)
+            {
+                size_t sampleSize = m_BitsPerSample / 8;
+                for (size_t i = HEADER_SIZE; i + sampleSize <= m_Output.size(); i += sampleSize)
+                    std::reverse(m_Output.begin() + i, m_Output.begin() + i + sampleSize);
+            }
+            writeHeader();
+        }
+
+    private:
+        static constexpr size_t HEADER_SIZE = 44;
+
+        size_t getFrameSize() const { return static_cast<size_t>(m_NumChannels) * m_BitsPerSample / 8; }
+
+        void writeHeader()
+        {
+            // RIFF sizes are 32-bit, a longer render is clamped to the largest size rather than wrapping around
+            uint64_t dataSize   = m_FrameCount * getFrameSize();
+            uint32_t blockAlign = static_cast<uint32_t>(getFrameSize());
+            uint32_t chunkSize  = static_cast<uint32_t>(std::min<uint64_t>(36 + dataSize, UINT32_MAX));
+            uint32_t dataBytes  = static_cast<uint32_t>(std::min<uint64_t>(dataSize, UINT32_MAX - 36));
+
+            char* header = m_Output.data();
+            auto  put    = [header](size_t offset, uint32_t value, size_t bytes) {
+                for (size_t i = 0; i < bytes; ++i)
+                    header[offset + i] = static_cast<char>(value >> (8 * i));
+            };
+
+            std::memcpy(&header[0], "RIFF", 4);    // Chunk ID
+            put(4, chunkSize, 4);                  // Chunk size
+            std::memcpy(&header[8], "WAVE", 4);    // Format
+            std::memcpy(&header[12], "fmt ", 4);   // Subchunk1 ID
+            put(16, 16, 4);                        // Subchunk1 size (16 for PCM)
+            put(20, m_BitsPerSample == 32 ? 3 : 1, 2); // Audio format (1 for PCM, 3 for IEEE float)
+            put(22, m_NumChannels, 2);             // Number of channels
+            put(24, m_SampleRate, 4);              // Sample rate
+            put(28, m_SampleRate * blockAlign, 4); // Byte rate
+            put(32, blockAlign, 2);                // Block align
+            put(34, m_BitsPerSample, 2);           // Bits per sample
+            std::memcpy(&header[36], "data", 4);   // Subchunk2 ID
+            put(40, dataBytes, 4);                 // Subchunk2 size
+        }
+
+    private:
+        jhunter::io::Buffer& m_Output;
+        int                  m_SampleRate;
+        int                  m_NumChannels;
+        int                  m_BitsPerSample;
+        uint64_t             m_FrameCount = 0;
+    };
+
+    // Glob match of a single path component, * matches any run of characters and ? a single one
+    bool matchWildcard(std::string_view pattern, std::string_view name)
+    {
+        size_t patternPos = 0;
+        size_t namePos    = 0;
+        size_t starPos    = std::string_view::npos; // Last * seen, to backtrack to on a mismatch
+        size_t starMatch  = 0;                      // Name position that * currently stretches to
+
+        while (namePos < name.size())
+        {
+            if (patternPos < pattern.size() && (pattern[patternPos] == '?' || pattern[patternPos] == name[namePos]))
+            {
+                ++patternPos;
+                ++namePos;
+            }
+            else if (patternPos < pattern.size() && pattern[patternPos] == '*')
+            {
+                starPos   = patternPos++;
+                starMatch = namePos;
+            }
+            else if (starPos != std::string_view::npos)
+            {
+                patternPos = starPos + 1;
+                namePos    = ++starMatch;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        while (patternPos < pattern.size() && pattern[patternPos] == '*')
+            ++patternPos;
+        return patternPos == pattern.size();
+    }
+
+    bool isJarFile(const std::filesystem::path& path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        return extension == ".jar";
+    }
+
+    // Worker of the TaskPool the current thread belongs to, if any
+    thread_local const void* t_TaskPool    = nullptr;
+    thread_local size_t      t_WorkerIndex = 0;
+
+    // Sink of hunters that have none configured, plain files written right away
+    jhunter::hunter::OutputSink& sinkOrDirect(const std::shared_ptr<jhunter::hunter::OutputSink>& sink)
+    {
+        static jhunter::hunter::DirectorySink directSink(false);
+        return sink ? *sink : directSink;
+    }
+} // namespace
+
+namespace jhunter
+{
+    namespace cli
+    {
+        bool isMultiInput(const std::string& input)
+        {
+            return input.find_first_of("*?") != std::string::npos || std::filesystem::is_directory(input);
+        }
+
+        std::vector<std::filesystem::path> collectInputs(const std::vector<std::string>& inputs,
+                                                         const std::string&              listFile)
+        {
+            std::vector<std::string> allInputs = inputs;
+            if (!listFile.empty())
+            {
+                std::ifstream list(listFile);
+                if (!list)
+                {
+                    std::cerr << "Error: Failed to open input list: " << listFile << std::endl;
+                    throw std::runtime_error("Failed to open input list.");
+                }
+
+                std::string line;
+                while (std::getline(list, line))
+                {
+                    // Trim surrounding whitespace, including the \r of CRLF lists
+                    size_t first = line.find_first_not_of(" \t\r");
+                    size_t last  = line.find_last_not_of(" \t\r");
+                    if (first == std::string::npos || line[first] == '#')
+                        continue;
+                    allInputs.push_back(line.substr(first, last - first + 1));
+                }
+            }
+
+            std::vector<std::filesystem::path> jars;
+            auto                               addJars = [&jars](std::vector<std::filesystem::path> found) {
+                std::sort(found.begin(), found.end());
+                jars.insert(jars.end(), found.begin(), found.end());
+            };
+
+            for (const auto& input : allInputs)
+            {
+                std::filesystem::path path(input);
+                std::string           pattern = path.filename().string();
+
+                if (pattern.find_first_of("*?") != std::string::npos)
+                {
+                    // Only the last component may be a pattern, the directory part is taken as is
+                    std::filesystem::path dir = path.has_parent_path() ? path.parent_path() : ".";
+                    if (!std::filesystem::is_directory(dir))
+                        continue;
+
+                    std::vector<std::filesystem::path> found;
+                    for (const auto& entry : std::filesystem::directory_iterator(dir))
+                    {
+                        if (entry.is_regular_file() && matchWildcard(pattern, entry.path().filename().string()))
+                            found.push_back(path.has_parent_path() ? entry.path() : entry.path().filename());
+                    }
+                    addJars(std::move(found));
+                }
+                else if (std::filesystem::is_directory(path))
+                {
+                    std::vector<std::filesystem::path> found;
+                    for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+                    {
+                        if (entry.is_regular_file() && isJarFile(entry.path()))
+                            found.push_back(entry.path());
+                    }
+                    addJars(std::move(found));
+                }
+                else
+                {
+                    // Plain files are passed through, a missing one is reported when it is opened
+                    jars.push_back(path);
+                }
+            }
+
+            // Drop repeated jars, keeping the first occurrence
+            std::vector<std::filesystem::path> uniqueJars;
+            std::unordered_set<std::string>    seen;
+            for (auto& jar : jars)
+            {
+                if (seen.insert(jar.lexically_normal().generic_string()).second)
+                    uniqueJars.push_back(std::move(jar));
+            }
+            return uniqueJars;
+        }
+
+        namespace
+        {
+            void appendUtf8(std::string& out, uint32_t code)
+            {
+                if (code < 0x80)
+                {
+                    out += static_cast<char>(code);
+                }
+                else if (code < 0x800)
+                {
+                    out += static_cast<char>(0xC0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else if (code < 0x10000)
+                {
+                    out += static_cast<char>(0xE0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += static_cast<char>(0xF0 | (code >> 18));
+                    out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    out += static_cast<char>(0x80 | (code & 0x3F));
+                }
+            }
+
+            class JsonReader
+            {
+            public:
+                explicit JsonReader(std::string_view text) : m_Text(text) {}
+
+                std::map<std::string, JsonValue> readObject()
+                {
+                    std::map<std::string, JsonValue> values;
+                    expect('{');
+                    if (peek() == '}')
+                    {
+                        ++m_Pos;
+                    }
+                    else
+                    {
+                        while (true)
+                        {
+                            std::string key = readString();
+                            expect(':');
+                            values[std::move(key)] = readValue();
+
+                            char next = peek();
+                            ++m_Pos;
+                            if (next == '}')
+                                break;
+                            if (next != ',')
+                                fail("expected , or }");
+                        }
+                    }
+
+                    if (peek() != '\0')
+                        fail("unexpected text after the object");
+                    return values;
+                }
+
+            private:
+                [[noreturn]] void fail(const std::string& what) const
+                {
+                    throw std::runtime_error("Invalid JSON at " + std::to_string(m_Pos) + ": " + what + ".");
+                }
+
+                // The next character that is not white space, \0 at the end
+                char peek()
+                {
+                    while (m_Pos < m_Text.size() && std::isspace(static_cast<unsigned char>(m_Text[m_Pos])))
+                        ++m_Pos;
+                    return m_Pos < m_Text.size() ? m_Text[m_Pos] : '\0';
+                }
+
+                void expect(char c)
+                {
+                    if (peek() != c)
+                        fail(std::string("expected ") + c);
+                    ++m_Pos;
+                }
+
+                uint32_t readHex4()
+                {
+                    if (m_Pos + 4 > m_Text.size())
+                        fail("truncated \\u escape");
+                    uint32_t code = 0;
+                    for (size_t i = 0; i < 4; ++i)
+                    {
+                        char     c = m_Text[m_Pos++];
+                        uint32_t digit;
+                        if (c >= '0' && c <= '9')
+                            digit = c - '0';
+                        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                            digit = (c | 0x20) - 'a' + 10;
+                        else
+                            fail("bad \\u escape");
+                        code = code << 4 | digit;
+                    }
+                    return code;
+                }
+
+                std::string readString()
+                {
+                    expect('"');
+                    std::string out;
+                    while (true)
+                    {
+                        if (m_Pos >= m_Text.size())
+                            fail("unterminated string");
+                        char c = m_Text[m_Pos++];
+                        if (c == '"')
+                            return out;
+                        if (static_cast<unsigned char>(c) < 0x20)
+                            fail("control character in string");
+                        if (c != '\\')
+                        {
+                            out += c;
+                            continue;
+                        }
+
+                        if (m_Pos >= m_Text.size())
+                            fail("unterminated string");
+                        switch (char escape = m_Text[m_Pos++])
+                        {
+                            case '"':
+                            case '\\':
+                            case '/':
+                                out += escape;
+                                break;
+                            case 'b':
+                                out += '\b';
+                                break;
+                            case 'f':
+                                out += '\f';
+                                break;
+                            case 'n':
+                                out += '\n';
+                                break;
+                            case 'r':
+                                out += '\r';
+                                break;
+                            case 't':
+                                out += '\t';
+                                break;
+                            case 'u': {
+                                uint32_t code = readHex4();
+                                // Characters beyond the BMP come as a surrogate pair
+                                if (code >= 0xD800 && code < 0xDC00 && m_Text.substr(m_Pos, 2) == "\\u")
+                                {
+                                    m_Pos += 2;
+                                    uint32_t low = readHex4();
+                                    if (low < 0xDC00 || low >= 0xE000)
+                                        fail("bad surrogate pair");
+                                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                                }
+                                appendUtf8(out, code);
+                                break;
+                            }
+                            default:
+                                fail("bad escape");
+                        }
+                    }
+                }
+
+                JsonValue readValue()
+                {
+                    char c = peek();
+                    if (c == '"')
+                        return {readString(), true};
+                    if (c == '{' || c == '[')
+                        fail("nested objects and arrays are not supported");
+
+                    size_t start = m_Pos;
+                    while (m_Pos < m_Text.size() && m_Text[m_Pos] != ',' && m_Text[m_Pos] != '}' &&
+                           !std::isspace(static_cast<unsigned char>(m_Text[m_Pos])))
+                        ++m_Pos;
+
+                    // Not a full number grammar, enough to tell a scalar from garbage
+                    std::string text(m_Text.substr(start, m_Pos - start));
+                    bool isNumber = !text.empty() && (std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '-') &&
+                                    text.find_first_not_of("0123456789+-.eE") == std::string::npos;
+                    if (!isNumber && text != "true" && text != "false" && text != "null")
+                        fail("bad value");
+                    return {std::move(text), false};
+                }
+
+            private:
+                std::string_view m_Text;
+                size_t           m_Pos = 0;
+            };
+
+#if !defined(_WIN32)
+            // A client of serveSocket. Closed once the reader and every pending reply are done with it
+            class Connection
+            {
+            public:
+                explicit Connection(int fd) : m_Fd(fd) {}
+                ~Connection() { close(m_Fd); }
+
+                Connection(const Connection&)            = delete;
+                Connection& operator=(const Connection&) = delete;
+
+                int getFd() const { return m_Fd; }
+
+                void send(const std::string& line)
+                {
+                    std::string       data = line + "\n";
+                    std::lock_guard   lock(m_Mutex);
+                    size_t            sent = 0;
+                    while (sent < data.size())
+                    {
+#if defined(MSG_NOSIGNAL)
+                        ssize_t n = ::send(m_Fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+#else
+                        ssize_t n = ::send(m_Fd, data.data() + sent, data.size() - sent, 0);
+#endif
+                        if (n < 0 && errno == EINTR)
+                            continue;
+                        if (n <= 0)
+                            return; // The client is gone, nobody is left to tell
+                        sent += static_cast<size_t>(n);
+                    }
+                }
+
+            private:
+                int        m_Fd;
+                std::mutex m_Mutex; // Replies of several jobs may finish at once
+            };
+
+            // Requests are single lines, anything longer is not one
+            constexpr size_t MAX_LINE_SIZE = 1024 * 1024;
+
+            void readLines(const std::shared_ptr<Connection>& connection,
+                           const LineHandler&                 onLine,
+                           const std::atomic<bool>&           stopping)
+            {
+                Reply reply = [connection](const std::string& line) { connection->send(line); };
+
+                std::string pending;
+                char        chunk[4096];
+                while (!stopping)
+                {
+                    // Wake up now and then to notice a stop
+                    pollfd client {connection->getFd(), POLLIN, 0};
+                    if (poll(&client, 1, 200) <= 0)
+                        continue;
+
+                    ssize_t n = recv(connection->getFd(), chunk, sizeof(chunk), 0);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0)
+                        return;
+                    pending.append(chunk, static_cast<size_t>(n));
+
+                    size_t start = 0;
+                    for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start))
+                    {
+                        std::string line = pending.substr(start, end - start);
+                        start            = end + 1;
+                        if (!line.empty() && line.back() == '\r')
+                            line.pop_back();
+                        if (line.find_first_not_of(" \t") == std::string::npos)
+                            continue;
+
+                        try
+                        {
+                            onLine(line, reply);
+                        }
+                        catch (const std::exception& error)
+                        {
+                            std::cerr << "Error: Failed to handle request: " << error.what() << std::endl;
+                        }
+                    }
+                    pending.erase(0, start);
+
+                    if (pending.size() > MAX_LINE_SIZE)
+                    {
+                        std::cerr << "Error: Dropping a client that sent a line over " << MAX_LINE_SIZE << " bytes"
+                                  << std::endl;
+                        return;
+                    }
+                }
+            }
+#endif
+        } // namespace
+
+        std::string JsonValue::toJson() const { return quoted ? quoteJson(text) : text; }
+
+        std::map<std::string, JsonValue> parseJsonObject(std::string_view text)
+        {
+            return JsonReader(text).readObject();
+        }
+
+        std::string quoteJson(std::string_view text)
+        {
+            std::string out = "\"";
+            for (char c : text)
+            {
+                switch (c)
+                {
+                    case '"':
+                        out += "\\\"";
+                        break;
+                    case '\\':
+                        out += "\\\\";
+                        break;
+                    case '\n':
+                        out += "\\n";
+                        break;
+                    case '\r':
+                        out += "\\r";
+                        break;
+                    case '\t':
+                        out += "\\t";
+                        break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20)
+                        {
+                            char escaped[8];
+                            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                            out += escaped;
+                        }
+                        else
+                        {
+                            out += c;
+                        }
+                }
+            }
+            return out + "\"";
+        }
+
+        void serveStdin(const LineHandler& onLine)
+        {
+            // Replies of several jobs may finish at once, and must not run into each other
+            static std::mutex outputMutex;
+            Reply             reply = [](const std::string& line) {
+                std::lock_guard lock(outputMutex);
+                std::cout << line << '\n' << std::flush;
+            };
+
+            std::string line;
+            while (std::getline(std::cin, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.find_first_not_of(" \t") == std::string::npos)
+                    continue;
+
+                try
+                {
+                    onLine(line, reply);
+                }
+                catch (const std::exception& error)
+                {
+                    std::cerr << "Error: Failed to handle request: " << error.what() << std::endl;
+                }
+            }
+        }
+
+        void serveSocket(const std::string& socketPath, const LineHandler& onLine, const std::atomic<bool>& stopping)
+        {
+#if defined(_WIN32)
+            (void)onLine;
+            (void)stopping;
+            std::cerr << "Error: Serving on a socket needs a POSIX system, serve on stdin instead: " << socketPath
+                      << std::endl;
+            throw std::runtime_error("Unix domain sockets are not supported.");
+#else
+            sockaddr_un address {};
+            address.sun_family = AF_UNIX;
+            if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+            {
+                std::cerr << "Error: Socket path is empty or too long: " << socketPath << std::endl;
+                throw std::runtime_error("Invalid socket path.");
+            }
+            std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+            // Only a socket is replaced, never a file that happens to have the same name
+            std::error_code error;
+            if (std::filesystem::is_socket(socketPath, error))
+                std::filesystem::remove(socketPath, error);
+
+            int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+                listen(listener, SOMAXCONN) != 0)
+            {
+                if (listener >= 0)
+                    close(listener);
+                std::cerr << "Error: Failed to listen on socket: " << socketPath << " (" << std::strerror(errno) << ")"
+                          << std::endl;
+                throw std::runtime_error("Failed to listen on socket.");
+            }
+
+            struct Client
+            {
+                std::thread       thread;
+                std::atomic<bool> done {false};
+            };
+            std::vector<std::unique_ptr<Client>> clients;
+
+            while (!stopping)
+            {
+                // Wake up now and then to notice a stop
+                pollfd server {listener, POLLIN, 0};
+                if (poll(&server, 1, 200) <= 0)
+                    continue;
+
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0)
+                    continue;
+#if defined(SO_NOSIGPIPE)
+                int noSigPipe = 1;
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+
+                // Join the clients that left, so a long-running server does not pile up threads
+                std::erase_if(clients, [](const std::unique_ptr<Client>& client) {
+                    if (!client->done)
+                        return false;
+                    client->thread.join();
+                    return true;
+                });
+
+                auto  connection = std::make_shared<Connection>(fd);
+                auto& client     = *clients.emplace_back(std::make_unique<Client>());
+                client.thread    = std::thread([connection, &client, &onLine, &stopping] {
+                    readLines(connection, onLine, stopping);
+                    client.done = true;
+                });
+            }
+
+            close(listener);
+            std::filesystem::remove(socketPath, error);
+            for (auto& client : clients)
+                client->thread.join();
+#endif
+        }
+    } // namespace cli
+
+    namespace stats
+    {
+        namespace
+        {
+            struct alignas(64) Slot
+            {
+                std::atomic<uint64_t> value {0};
+            };
+
+            std::array<Slot, static_cast<size_t>(Counter::Count)> g_Counters;
+
+            uint64_t get(Counter counter)
+            {
+                return g_Counters[static_cast<size_t>(counter)].value.load(std::memory_order_relaxed);
+            }
+
+            double seconds(Counter counter) { return static_cast<double>(get(counter)) / 1e9; }
+        } // namespace
+
+        void add(Counter counter, uint64_t value)
+        {
+            g_Counters[static_cast<size_t>(counter)].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        void raise(Counter counter, uint64_t value)
+        {
+            auto& slot    = g_Counters[static_cast<size_t>(counter)].value;
+            auto  current = slot.load(std::memory_order_relaxed);
+            while (current < value && !slot.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        ScopedTimer::~ScopedTimer()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - m_Start;
+            add(m_Counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+
+        std::string Stats::toJson() const
+        {
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(6);
+            json << "{\n";
+            json << "  \"entriesInflated\": " << entriesInflated << ",\n";
+            json << "  \"bytesInflated\": " << bytesInflated << ",\n";
+            json << "  \"inflateSeconds\": " << inflateSeconds << ",\n";
+            json << "  \"entriesMapped\": " << entriesMapped << ",\n";
+            json << "  \"bytesMapped\": " << bytesMapped << ",\n";
+            json << "  \"entriesSkipped\": " << entriesSkipped << ",\n";
+            json << "  \"bytesSkipped\": " << bytesSkipped << ",\n";
+            json << "  \"bytesScanned\": " << bytesScanned << ",\n";
+            json << "  \"scanSeconds\": " << scanSeconds << ",\n";
+            json << "  \"bytesParsed\": " << bytesParsed << ",\n";
+            json << "  \"parseSeconds\": " << parseSeconds << ",\n";
+            json << "  \"signatureMatches\": " << signatureMatches << ",\n";
+            json << "  \"rejectedCandidates\": " << rejectedCandidates << ",\n";
+            json << "  \"pngsCarved\": " << pngsCarved << ",\n";
+            json << "  \"midisCarved\": " << midisCarved << ",\n";
+            json << "  \"bytesCopied\": " << bytesCopied << ",\n";
+            json << "  \"filesWritten\": " << filesWritten << ",\n";
+            json << "  \"bytesWritten\": " << bytesWritten << ",\n";
+            json << "  \"writeSeconds\": " << writeSeconds << ",\n";
+            json << "  \"wavsRendered\": " << wavsRendered << ",\n";
+            json << "  \"renderSeconds\": " << renderSeconds << ",\n";
+            json << "  \"audioSeconds\": " << audioSeconds << ",\n";
+            json << "  \"wavsCutByDuration\": " << wavsCutByDuration << ",\n";
+            json << "  \"wavsCutByTime\": " << wavsCutByTime << ",\n";
+            json << "  \"wavsCutBySilence\": " << wavsCutBySilence << ",\n";
+            json << "  \"embeddedStreams\": " << embeddedStreams << ",\n";
+            json << "  \"bytesEmbedded\": " << bytesEmbedded << ",\n";
+            json << "  \"embeddedSeconds\": " << embeddedSeconds << ",\n";
+            json << "  \"arenaBytes\": " << arenaBytes << ",\n";
+            json << "  \"arenaJarPeak\": " << arenaJarPeak << ",\n";
+            json << "  \"arenaPeak\": " << arenaPeak << "\n";
+            json << "}\n";
+            return json.str();
+        }
+
+        Stats getStats()
+        {
+            Stats stats;
+            stats.entriesInflated    = get(Counter::EntriesInflated);
+            stats.bytesInflated      = get(Counter::BytesInflated);
+            stats.inflateSeconds     = seconds(Counter::InflateNanos);
+            stats.entriesMapped      = get(Counter::EntriesMapped);
+            stats.bytesMapped        = get(Counter::BytesMapped);
+            stats.entriesSkipped     = get(Counter::EntriesSkipped);
+            stats.bytesSkipped       = get(Counter::BytesSkipped);
+            stats.bytesScanned       = get(Counter::BytesScanned);
+            stats.scanSeconds        = seconds(Counter::ScanNanos);
+            stats.bytesParsed        = get(Counter::BytesParsed);
+            stats.parseSeconds       = seconds(Counter::ParseNanos);
+            stats.signatureMatches   = get(Counter::SignatureMatches);
+            stats.rejectedCandidates = get(Counter::RejectedCandidates);
+            stats.pngsCarved         = get(Counter::PngsCarved);
+            stats.midisCarved        = get(Counter::MidisCarved);
+            stats.bytesCopied        = get(Counter::BytesCopied);
+            stats.filesWritten       = get(Counter::FilesWritten);
+            stats.bytesWritten       = get(Counter::BytesWritten);
+            stats.writeSeconds       = seconds(Counter::WriteNanos);
+            stats.wavsRendered       = get(Counter::WavsRendered);
+            stats.renderSeconds      = seconds(Counter::RenderNanos);
+            stats.audioSeconds       = seconds(Counter::AudioNanos);
+            stats.wavsCutByDuration  = get(Counter::WavsCutByDuration);
+            stats.wavsCutByTime      = get(Counter::WavsCutByTime);
+            stats.wavsCutBySilence   = get(Counter::WavsCutBySilence);
+            stats.embeddedStreams    = get(Counter::EmbeddedStreams);
+            stats.bytesEmbedded      = get(Counter::BytesEmbedded);
+            stats.embeddedSeconds    = seconds(Counter::EmbeddedNanos);
+            stats.arenaBytes         = get(Counter::ArenaBytes);
+            stats.arenaJarPeak       = get(Counter::ArenaJarPeak);
+            stats.arenaPeak          = get(Counter::ArenaPeak);
+            return stats;
+        }
+
+        void resetStats()
+        {
+            for (auto& slot : g_Counters)
+                slot.value.store(0, std::memory_order_relaxed);
+        }
+    } // namespace stats
+
+    namespace memory
+    {
+        namespace
+        {
+            // Bytes held by all arenas alive right now, for stats::Counter::ArenaPeak
+            std::atomic<size_t> g_ArenaBytesAlive {0};
+        } // namespace
+
+        Arena::Arena(std::pmr::memory_resource* upstream) : m_Counting(upstream, m_Taken), m_Monotonic(&m_Counting) {}
+
+        Arena::~Arena()
+        {
+            size_t taken = m_Taken.load(std::memory_order_relaxed);
+            stats::add(stats::Counter::ArenaBytes, taken);
+            stats::raise(stats::Counter::ArenaJarPeak, taken);
+            g_ArenaBytesAlive.fetch_sub(taken, std::memory_order_relaxed);
+        }
+
+        void* Arena::do_allocate(size_t bytes, size_t alignment)
+        {
+            std::lock_guard lock(m_Mutex);
+            return m_Monotonic.allocate(bytes, alignment);
+        }
+
+        // Memory comes back when the arena dies, like with any monotonic resource
+        void Arena::do_deallocate(void*, size_t, size_t) {}
+
+        bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept { return this == &other; }
+
+        void* Arena::Counting::do_allocate(size_t bytes, size_t alignment)
+        {
+            void* p = m_Upstream->allocate(bytes, alignment);
+            m_Taken.fetch_add(bytes, std::memory_order_relaxed);
+            size_t alive = g_ArenaBytesAlive.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            stats::raise(stats::Counter::ArenaPeak, alive);
+            return p;
+        }
+
+        void Arena::Counting::do_deallocate(void* p, size_t bytes, size_t alignment)
+        {
+            m_Upstream->deallocate(p, bytes, alignment);
+        }
+    } // namespace memory
+
+    namespace io
+    {
+        uint32_t crc32(uint32_t crc, const void* data, size_t size)
+        {
+            return crc32Update(crc, static_cast<const unsigned char*>(data), size);
+        }
+
+        const char* getCrc32KernelName()
+        {
+            switch (detectCrc32Kernel())
+            {
+                case Crc32Kernel::SliceBy8:
+                    return "slice-by-8";
+                case Crc32Kernel::PCLMUL:
+                    return "pclmul";
+                case Crc32Kernel::ArmCRC:
+                    return "armv8-crc";
+            }
+            return "unknown";
+        }
+
+        MappedFile::MappedFile(const std::string& path)
+        {
+#if defined(_WIN32)
+            HANDLE file = CreateFileW(std::filesystem::path(path).wstring().c_str(),
+                                      GENERIC_READ,
+                                      FILE_SHARE_READ,
+                                      nullptr,
+                                      OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL,
+                                      nullptr);
+            LARGE_INTEGER fileSize {};
+            if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+            {
+                if (file != INVALID_HANDLE_VALUE)
+                    CloseHandle(file);
+                std::cerr << "Error opening file for mapping: " << path << std::endl;
+                throw std::runtime_error("Failed to open file.");
+            }
+
+            // An empty file can not be mapped, it simply has no bytes
+            if (fileSize.QuadPart > 0)
+            {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                void*  view    = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+                if (mapping)
+                    CloseHandle(mapping); // The view keeps the mapping alive
+                if (!view)
+                {
+                    CloseHandle(file);
+                    std::cerr << "Error mapping file: " << path << std::endl;
+                    throw std::runtime_error("Failed to map file.");
+                }
+                m_Data = static_cast<const char*>(view);
+                m_Size = static_cast<size_t>(fileSize.QuadPart);
+            }
+            CloseHandle(file);
+#else
+            int file = open(path.c_str(), O_RDONLY);
+            struct stat st {};
+            if (file < 0 || fstat(file, &st) != 0)
+            {
+                if (file >= 0)
+                    close(file);
+                std::cerr << "Error opening file for mapping: " << path << std::endl;
+                throw std::runtime_error("Failed to open file.");
+            }
+
+            // An empty file can not be mapped, it simply has no bytes
+            if (st.st_size > 0)
+            {
+                void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+                if (view == MAP_FAILED)
+                {
+                    close(file);
+                    std::cerr << "Error mapping file: " << path << std::endl;
+                    throw std::runtime_error("Failed to map file.");
+                }
+                m_Data = static_cast<const char*>(view);
+                m_Size = static_cast<size_t>(st.st_size);
+            }
+            close(file); // The mapping stays valid without the descriptor
+#endif
+        }
+
+        MappedFile::~MappedFile()
+        {
+            if (!m_Data)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(m_Data);
+#else
+            munmap(const_cast<char*>(m_Data), m_Size);
+#endif
+        }
+
+        struct ZipArchive::Mapping
+        {
+            explicit Mapping(const std::string& path) : file(path) {}
+
+            MappedFile            file;
+            std::vector<ByteSpan> views;  // Per entry, the bytes of STORED entries in the mapping
+            std::vector<uint32_t> crcs;   // Per entry, the CRC-32 of the central directory
+            std::vector<bool>     stored; // Per entry, whether views holds it
+        };
+
+        ZipArchive::ZipArchive(const std::string& zipPath, const ArchiveSettings& settings) :
+            m_ZipPath(zipPath), m_ZipHandle(openZip(zipPath)), m_Settings(settings)
+        {
+            size_t numEntries = getNumEntries();
+
+            if (settings.memoryMap)
+            {
+                auto mapping = std::make_shared<Mapping>(zipPath);
+                auto located = locateStoredEntries(mapping->file.data(), mapping->file.size());
+
+                // Indices are shared with libzip, so the mapping is only used when both read the same directory.
+                // Otherwise every entry is read through libzip as before
+                if (located.size() == numEntries)
+                {
+                    mapping->views.resize(numEntries);
+                    mapping->crcs.resize(numEntries);
+                    mapping->stored.resize(numEntries);
+                    for (size_t i = 0; i < numEntries; ++i)
+                    {
+                        if (!located[i].stored)
+                            continue;
+                        mapping->views[i]  = ByteSpan(mapping->file.data() + located[i].offset, located[i].size);
+                        mapping->crcs[i]   = located[i].crc;
+                        mapping->stored[i] = true;
+                    }
+                    m_Mapping = std::move(mapping);
+                }
+            }
+
+            if (settings.filter)
+            {
+                const EntryFilter& filter = *settings.filter;
+                m_Skipped.resize(numEntries);
+                for (size_t i = 0; i < numEntries; ++i)
+                {
+                    struct zip_stat st;
+                    zip_stat_init(&st);
+                    if (zip_stat_index(m_ZipHandle.get(), i, 0, &st) != 0)
+                        continue; // Left to readEntry, which reports it
+
+                    std::string_view name    = st.name ? st.name : "";
+                    bool             skipped = std::any_of(filter.skipNames.begin(),
+                                                filter.skipNames.end(),
+                                                [&](const std::string& pattern) { return matchWildcard(pattern, name); });
+                    skipped |= st.size < filter.minSize;
+                    skipped |= filter.maxSize > 0 && st.size > filter.maxSize;
+                    if (filter.skipUnreadable)
+                    {
+                        skipped |= (st.valid & ZIP_STAT_ENCRYPTION_METHOD) && st.encryption_method != ZIP_EM_NONE;
+                        skipped |= (st.valid & ZIP_STAT_COMP_METHOD) && !zip_compression_method_supported(st.comp_method, 0);
+                    }
+
+                    m_Skipped[i] = skipped;
+                    if (skipped)
+                    {
+                        stats::add(stats::Counter::EntriesSkipped, 1);
+                        stats::add(stats::Counter::BytesSkipped, st.size);
+                    }
+                }
+            }
+        }
+
+        std::pmr::vector<std::pmr::string> ZipArchive::listEntries(std::pmr::memory_resource* resource) const
+        {
+            std::pmr::vector<std::pmr::string> entries(resource);
+            zip_int64_t                        num_entries = zip_get_num_entries(m_ZipHandle.get(), 0);
+            for (zip_int64_t i = 0; i < num_entries; ++i)
+            {
+                const char* name = zip_get_name(m_ZipHandle.get(), i, 0);
+                if (name)
+                {
+                    entries.emplace_back(name);
+                }
+            }
+            return entries;
+        }
+
+        Buffer ZipArchive::readFile(std::string_view name, std::pmr::memory_resource* resource) const
+        {
+            std::string fileName(name);
+
+            struct zip_stat st;
+            zip_stat_init(&st);
+            if (zip_stat(m_ZipHandle.get(), fileName.c_str(), 0, &st) != 0)
+            {
+                std::cerr << "Error getting file stat: " << fileName << std::endl;
+                throw std::runtime_error("Failed to get file stat.");
+            }
+
+            std::unique_ptr<zip_file_t, ZipFileDeleter> file(zip_fopen(m_ZipHandle.get(), fileName.c_str(), 0));
+            if (!file)
+            {
+                std::cerr << "Error opening file: " << fileName << std::endl;
+                throw std::runtime_error("Failed to open file.");
+            }
+
+            Buffer buffer(st.size, resource);
+            zip_fread(file.get(), buffer.data(), buffer.size());
+
+            return buffer;
+        }
+
+        size_t ZipArchive::getNumEntries() const
+        {
+            zip_int64_t numEntries = zip_get_num_entries(m_ZipHandle.get(), 0);
+            return numEntries > 0 ? static_cast<size_t>(numEntries) : 0;
+        }
+
+        std::string ZipArchive::getEntryName(size_t index) const
+        {
+            const char* name = zip_get_name(m_ZipHandle.get(), index, 0);
+            return name ? name : "";
+        }
+
+        uint64_t ZipArchive::getFingerprint() const
+        {
+            Xxh64 hash;
+            auto  add = [&hash](const void* data, size_t size) {
+                hash.update(static_cast<const unsigned char*>(data), size);
+            };
+
+            size_t numEntries = getNumEntries();
+            add(&numEntries, sizeof(numEntries));
+            for (size_t i = 0; i < numEntries; ++i)
+            {
+                struct zip_stat st;
+                zip_stat_init(&st);
+                if (zip_stat_index(m_ZipHandle.get(), i, 0, &st) != 0)
+                {
+                    std::cerr << "Error getting file stat of entry: " << i << std::endl;
+                    throw std::runtime_error("Failed to get file stat.");
+                }
+
+                // The name is hashed with its terminator so neighbouring names can not run into each other
+                std::string_view name = st.name ? st.name : "";
+                add(name.data(), name.size() + 1);
+                add(&st.crc, sizeof(st.crc));
+                add(&st.size, sizeof(st.size));
+                add(&st.comp_size, sizeof(st.comp_size));
+                add(&st.comp_method, sizeof(st.comp_method));
+            }
+            return hash.digest();
+        }
+
+        Buffer ZipArchive::readEntry(size_t index, std::pmr::memory_resource* resource) const
+        {
+            return readZipEntry(m_ZipHandle.get(), index, resource);
+        }
+
+        bool ZipArchive::verifyEntry(size_t index, ByteSpan buffer) const
+        {
+            struct zip_stat st;
+            zip_stat_init(&st);
+            if (zip_stat_index(m_ZipHandle.get(), index, 0, &st) != 0)
+            {
+                std::cerr << "Error getting file stat of entry: " << index << std::endl;
+                throw std::runtime_error("Failed to get file stat.");
+            }
+
+            return st.size == buffer.size() && st.crc == crc32(0, buffer.data(), buffer.size());
+        }
+
+        SharedBytes ZipArchive::readShared(zip_t*                                            handle,
+                                           size_t                                            index,
+                                           const std::shared_ptr<std::pmr::memory_resource>& owner) const
+        {
+            if (isSkipped(index))
+                return std::make_shared<const ByteSpan>();
+
+            if (m_Mapping && m_Mapping->stored[index])
+            {
+                const ByteSpan& view = m_Mapping->views[index];
+
+                // libzip checks the CRC-32 of every entry it reads, the mapping is read around it
+                if (m_Settings.verifyMappedCRC && crc32(0, view.data(), view.size()) != m_Mapping->crcs[index])
+                {
+                    std::cerr << "Error reading entry: " << index << " (CRC mismatch)" << std::endl;
+                    throw std::runtime_error("Failed to read file.");
+                }
+
+                stats::add(stats::Counter::EntriesMapped, 1);
+                stats::add(stats::Counter::BytesMapped, view.size());
+                return SharedBytes(m_Mapping, &view);
+            }
+
+            Buffer buffer = readZipEntry(handle, index, owner ? owner.get() : std::pmr::get_default_resource());
+            return owner ? hunter::makeSharedBuffer(std::move(buffer), owner) :
+                           hunter::makeSharedBuffer(std::move(buffer));
+        }
+
+        std::vector<SharedBytes> ZipArchive::readEntries(size_t                                     first,
+                                                         size_t                                     count,
+                                                         std::shared_ptr<std::pmr::memory_resource> owner) const
+        {
+            size_t numEntries = getNumEntries();
+            first             = std::min(first, numEntries);
+            count             = std::min(count, numEntries - first);
+
+            auto                     handle = openZip(m_ZipPath);
+            std::vector<SharedBytes> buffers;
+            buffers.reserve(count);
+            for (size_t i = first; i < first + count; ++i)
+                buffers.push_back(readShared(handle.get(), i, owner));
+            return buffers;
+        }
+
+        std::vector<SharedBytes> ZipArchive::readAllEntries(size_t                                     threadCount,
+                                                            std::shared_ptr<std::pmr::memory_resource> owner) const
+        {
+            size_t                   numEntries = getNumEntries();
+            std::vector<SharedBytes> buffers(numEntries);
+
+            threadCount = std::min(threadCount, numEntries);
+            if (threadCount <= 1)
+            {
+                for (size_t i = 0; i < numEntries; ++i)
+                    buffers[i] = readShared(m_ZipHandle.get(), i, owner);
+                return buffers;
+            }
+
+            // A zip_t must not be shared between threads, so every worker opens the archive again and
+            // pulls the next entry index from a shared counter. Each result goes to its own slot.
+            std::atomic<size_t>             nextIndex {0};
+            std::vector<std::exception_ptr> errors(threadCount);
+            std::vector<std::thread>        workers;
+            workers.reserve(threadCount);
+
+            for (size_t worker = 0; worker < threadCount; ++worker)
+            {
+                workers.emplace_back([&, worker] {
+                    try
+                    {
+                        auto handle = openZip(m_ZipPath);
+                        for (size_t i = nextIndex++; i < numEntries; i = nextIndex++)
+                            buffers[i] = readShared(handle.get(), i, owner);
+                    }
+                    catch (...)
+                    {
+                        errors[worker] = std::current_exception();
+                        nextIndex      = numEntries; // Stop the other workers early
+                    }
+                });
+            }
+
+            for (auto& worker : workers)
+                worker.join();
+
+            for (const auto& error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+            return buffers;
+        }
+
+        void ZipArchive::streamEntries(size_t threadCount, const EntryCallback& onEntry, size_t memoryLimit) const
+        {
+            size_t numEntries = getNumEntries();
+
+            threadCount = std::min(threadCount, numEntries);
+            if (threadCount <= 1)
+            {
+                for (size_t i = 0; i < numEntries; ++i)
+                {
+                    if (!onEntry(i, readShared(m_ZipHandle.get(), i, nullptr)))
+                        break;
+                }
+                return;
+            }
+
+            // Workers inflate out of order but take turns to deliver: an entry is handed over only once every entry
+            // before it has been. At most one inflated entry per worker waits for its turn, and together they stay
+            // within memoryLimit by the sizes of the central directory. Skipped and mapped STORED entries take none
+            std::vector<uint64_t> entrySizes(numEntries);
+            for (size_t i = 0; memoryLimit > 0 && i < numEntries; ++i)
+            {
+                if (isSkipped(i) || (m_Mapping && m_Mapping->stored[i]))
+                    continue;
+
+                struct zip_stat st;
+                zip_stat_init(&st);
+                if (zip_stat_index(m_ZipHandle.get(), i, 0, &st) != 0)
+                {
+                    std::cerr << "Error getting file stat of entry: " << i << std::endl;
+                    throw std::runtime_error("Failed to get file stat.");
+                }
+                entrySizes[i] = st.size;
+            }
+
+            std::atomic<size_t>             nextIndex {0};
+            std::mutex                      turnMutex;
+            std::condition_variable         turnChanged;
+            size_t                          turn     = 0;
+            uint64_t                        inFlight = 0; // Bytes of the entries inflated and not handed over yet
+            bool                            stopped  = false;
+            std::vector<std::exception_ptr> errors(threadCount);
+            std::vector<std::thread>        workers;
+            workers.reserve(threadCount);
+
+            auto stop = [&] {
+                std::lock_guard lock(turnMutex);
+                stopped   = true;
+                nextIndex = numEntries;
+                turnChanged.notify_all();
+            };
+
+            for (size_t worker = 0; worker < threadCount; ++worker)
+            {
+                workers.emplace_back([&, worker] {
+                    try
+                    {
+                        auto handle = openZip(m_ZipPath);
+                        for (size_t i = nextIndex++; i < numEntries; i = nextIndex++)
+                        {
+                            // Wait for room first. The entry whose turn it is always goes ahead, however large, so
+                            // the stream keeps moving
+                            {
+                                std::unique_lock lock(turnMutex);
+                                turnChanged.wait(lock, [&] {
+                                    return stopped || memoryLimit == 0 || turn == i ||
+                                           inFlight + entrySizes[i] <= memoryLimit;
+                                });
+                                if (stopped)
+                                    return;
+                                inFlight += entrySizes[i];
+                            }
+
+                            // From the heap, so every entry is freed as soon as the stream is done with it
+                            auto buffer = readShared(handle.get(), i, nullptr);
+
+                            std::unique_lock lock(turnMutex);
+                            turnChanged.wait(lock, [&] { return stopped || turn == i; });
+                            if (stopped)
+                                return;
+
+                            // The callback may block, e.g. on a full queue; holding the turn keeps the order
+                            bool proceed = onEntry(i, std::move(buffer));
+                            inFlight -= entrySizes[i];
+                            ++turn;
+                            if (!proceed)
+                            {
+                                stopped   = true;
+                                nextIndex = numEntries;
+                            }
+                            turnChanged.notify_all();
+                        }
+                    }
+                    catch (...)
+                    {
+                        errors[worker] = std::current_exception();
+                        stop();
+                    }
+                });
+            }
+
+            for (auto& worker : workers)
+                worker.join();
+
+            for (const auto& error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        }
+
+        std::vector<Buffer> inflateEmbeddedStreams(ByteSpan                      buffer,
+                                                   const EmbeddedStreamSettings& settings,
+                                                   std::pmr::memory_resource*    resource)
+        {
+            stats::ScopedTimer timer(stats::Counter::EmbeddedNanos);
+            return EmbeddedStreamScan(settings, resource).run(buffer);
+        }
+    } // namespace io
+
+    namespace search
+    {
+        Kernel detectKernel()
+        {
+            static const Kernel kernel = [] {
+#ifdef JHUNTER_X86
+                if (cpuHasAVX2())
+                    return Kernel::AVX2;
+                if (cpuHasSSE2())
+                    return Kernel::SSE2;
+#endif
+                return Kernel::Scalar;
+            }();
+            return kernel;
+        }
+
+        bool isKernelSupported(Kernel kernel) { return kernel <= detectKernel(); }
+
+        const char* getKernelName(Kernel kernel)
+        {
+            switch (kernel)
+            {
+                case Kernel::Scalar:
+                    return "scalar";
+                case Kernel::SSE2:
+                    return "sse2";
+                case Kernel::AVX2:
+                    return "avx2";
+            }
+            return "unknown";
+        }
+
+        BytePattern::BytePattern(std::string_view bytes) : m_Bytes(bytes), m_Kernel(detectKernel()) {}
+
+        void BytePattern::setKernel(Kernel kernel)
+        {
+            if (!isKernelSupported(kernel))
+            {
+                std::cerr << "Error: Search kernel not supported by this CPU: " << getKernelName(kernel) << std::endl;
+                throw std::runtime_error("Search kernel not supported.");
+            }
+            m_Kernel = kernel;
+        }
+
+        size_t BytePattern::find(const char* data, size_t size, size_t startPos) const
+        {
+            switch (m_Kernel)
+            {
+#ifdef JHUNTER_X86
+                case Kernel::AVX2:
+                    return findAVX2(data, size, m_Bytes.data(), m_Bytes.size(), startPos);
+                case Kernel::SSE2:
+                    return findSSE2(data, size, m_Bytes.data(), m_Bytes.size(), startPos);
+#endif
+                default:
+                    return findScalar(data, size, m_Bytes.data(), m_Bytes.size(), startPos);
+            }
+        }
+
+        void MatchTable::add(const BytePattern* pattern, size_t position)
+        {
+            for (auto& entry : m_Entries)
+            {
+                if (entry.pattern == pattern)
+                {
+                    entry.positions.push_back(position);
+                    return;
+                }
+            }
+            m_Entries.push_back({pattern, {position}});
+        }
+
+        void MatchTable::addPattern(const BytePattern* pattern)
+        {
+            if (!findEntry(pattern))
+                m_Entries.push_back({pattern, {}});
+        }
+
+        bool MatchTable::contains(const BytePattern& pattern) const { return findEntry(&pattern) != nullptr; }
+
+        size_t MatchTable::find(const BytePattern& pattern, size_t startPos) const
+        {
+            const Entry* entry = findEntry(&pattern);
+            if (!entry)
+                return BytePattern::npos;
+
+            auto it = std::lower_bound(entry->positions.begin(), entry->positions.end(), startPos);
+            return it != entry->positions.end() ? *it : BytePattern::npos;
+        }
+
+        MatchTable MatchTable::select(const std::vector<const BytePattern*>& patterns) const
+        {
+            MatchTable table;
+            for (const auto* pattern : patterns)
+            {
+                const Entry* entry = findEntry(pattern);
+                table.m_Entries.push_back({pattern, entry ? entry->positions : std::vector<size_t> {}});
+            }
+            return table;
+        }
+
+        const MatchTable::Entry* MatchTable::findEntry(const BytePattern* pattern) const
+        {
+            // Tables hold a handful of patterns, a linear scan beats any map
+            for (const auto& entry : m_Entries)
+            {
+                if (entry.pattern == pattern)
+                    return &entry;
+            }
+            return nullptr;
+        }
+
+        void MultiPattern::addPattern(const BytePattern* pattern)
+        {
+            if (pattern->size() == 0)
+            {
+                std::cerr << "Error: Cannot add an empty pattern to a multi-pattern automaton." << std::endl;
+                throw std::runtime_error("Empty search pattern.");
+            }
+            if (std::find(m_Patterns.begin(), m_Patterns.end(), pattern) == m_Patterns.end())
+                m_Patterns.push_back(pattern);
+            m_Compiled = false;
+        }
+
+        void MultiPattern::compile()
+        {
+            // Build the trie, missing edges are filled in by the breadth-first pass below
+            m_Transitions.assign(256, AC_MISSING);
+            std::vector<std::vector<uint32_t>> outputs(1);
+            m_FirstBytes.clear();
+            m_LastBytes.clear();
+            m_LastOffsets.clear();
+
+            for (uint32_t id = 0; id < m_Patterns.size(); ++id)
+            {
+                const std::string& bytes = m_Patterns[id]->bytes();
+                addCandidateFilter(bytes.front(), bytes.back(), bytes.size() - 1);
+
+                uint32_t state = AC_ROOT;
+                for (char c : bytes)
+                {
+                    uint32_t& next = m_Transitions[state * 256 + static_cast<unsigned char>(c)];
+                    if (next == AC_MISSING)
+                    {
+                        next = static_cast<uint32_t>(outputs.size());
+                        outputs.emplace_back();
+                        m_Transitions.resize(m_Transitions.size() + 256, AC_MISSING);
+                    }
+                    state = m_Transitions[state * 256 + static_cast<unsigned char>(c)];
+                }
+                outputs[state].push_back(id);
+            }
+
+            // Turn the trie into a DFA: every missing edge follows the failure link of its state
+            std::vector<uint32_t> failure(outputs.size(), AC_ROOT);
+            std::vector<uint32_t> queue;
+            for (uint32_t c = 0; c < 256; ++c)
+            {
+                uint32_t& next = m_Transitions[c];
+                if (next == AC_MISSING)
+                    next = AC_ROOT;
+                else
+                    queue.push_back(next);
+            }
+
+            for (size_t head = 0; head < queue.size(); ++head)
+            {
+                uint32_t state = queue[head];
+                for (uint32_t c = 0; c < 256; ++c)
+                {
+                    uint32_t  fallback = m_Transitions[failure[state] * 256 + c];
+                    uint32_t& next     = m_Transitions[state * 256 + c];
+                    if (next == AC_MISSING)
+                    {
+                        next = fallback;
+                        continue;
+                    }
+
+                    failure[next] = fallback;
+                    outputs[next].insert(outputs[next].end(), outputs[fallback].begin(), outputs[fallback].end());
+                    queue.push_back(next);
+                }
+            }
+
+            m_OutputOffsets.assign(1, 0);
+            m_Outputs.clear();
+            for (const auto& ids : outputs)
+            {
+                m_Outputs.insert(m_Outputs.end(), ids.begin(), ids.end());
+                m_OutputOffsets.push_back(static_cast<uint32_t>(m_Outputs.size()));
+            }
+
+            m_Compiled = true;
+        }
+
+        MatchTable MultiPattern::scan(const char* data, size_t size) const
+        {
+            if (!m_Compiled)
+            {
+                std::cerr << "Error: Multi-pattern automaton used before compile()." << std::endl;
+                throw std::runtime_error("Multi-pattern automaton not compiled.");
+            }
+
+            MatchTable table;
+            for (const auto* pattern : m_Patterns)
+                table.addPattern(pattern);
+
+            uint32_t state = AC_ROOT;
+            size_t   i     = 0;
+            while (i < size)
+            {
+                // No match can start between candidates, so from the root state jump straight to the next one
+                if (state == AC_ROOT)
+                {
+                    i = skipToCandidate(data, size, i);
+                    if (i >= size)
+                        break;
+                }
+
+                state = m_Transitions[state * 256 + static_cast<unsigned char>(data[i])];
+                for (uint32_t k = m_OutputOffsets[state]; k < m_OutputOffsets[state + 1]; ++k)
+                {
+                    const BytePattern* pattern = m_Patterns[m_Outputs[k]];
+                    table.add(pattern, i + 1 - pattern->size());
+                }
+                ++i;
+            }
+
+            return table;
+        }
+
+        void MultiPattern::addCandidateFilter(char firstByte, char lastByte, size_t lastOffset)
+        {
+            for (size_t k = 0; k < m_FirstBytes.size(); ++k)
+            {
+                if (m_FirstBytes[k] == firstByte && m_LastBytes[k] == lastByte && m_LastOffsets[k] == lastOffset)
+                    return;
+            }
+            m_FirstBytes.push_back(firstByte);
+            m_LastBytes.push_back(lastByte);
+            m_LastOffsets.push_back(lastOffset);
+        }
+
+        size_t MultiPattern::skipToCandidate(const char* data, size_t size, size_t pos) const
+        {
+            if (m_FirstBytes.empty())
+                return size;
+
+            CandidateFilter filter {m_FirstBytes.data(),
+                                    m_LastBytes.data(),
+                                    m_LastOffsets.data(),
+                                    m_FirstBytes.size(),
+                                    *std::max_element(m_LastOffsets.begin(), m_LastOffsets.end())};
+
+#ifdef JHUNTER_X86
+            Kernel kernel = detectKernel();
+            if (kernel != Kernel::Scalar && filter.count <= AC_SIMD_MAX_FILTERS)
+                return findCandidateSIMD(kernel, data, size, filter, pos);
+#endif
+            return findCandidateScalar(data, size, filter, pos);
+        }
+    } // namespace search
+
+    namespace pipeline
+    {
+        TaskPool::TaskPool(size_t threadCount)
+        {
+            threadCount = std::max<size_t>(threadCount, 1);
+            for (size_t i = 0; i < threadCount; ++i)
+                m_Workers.push_back(std::make_unique<Worker>());
+
+            m_Threads.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i)
+                m_Threads.emplace_back([this, i] { workerLoop(i); });
+        }
+
+        TaskPool::~TaskPool()
+        {
+            // Pending tasks still run before the workers leave
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_TaskAdded.notify_all();
+
+            for (auto& thread : m_Threads)
+                thread.join();
+        }
+
+        void TaskPool::submit(Task task)
+        {
+            size_t target;
+            bool   fromWorker = t_TaskPool == this;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                ++m_Unfinished;
+                ++m_Queued;
+                target = fromWorker ? t_WorkerIndex : m_NextWorker++ % m_Workers.size();
+            }
+
+            {
+                // Tasks of a worker go in front so it picks them up first, outside tasks queue up behind
+                Worker&                     worker = *m_Workers[target];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if (fromWorker)
+                    worker.tasks.push_front(std::move(task));
+                else
+                    worker.tasks.push_back(std::move(task));
+            }
+            m_TaskAdded.notify_one();
+        }
+
+        void TaskPool::wait()
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_AllDone.wait(lock, [this] { return m_Unfinished == 0; });
+
+            if (m_Error)
+                std::rethrow_exception(std::exchange(m_Error, nullptr));
+        }
+
+        bool TaskPool::takeTask(size_t index, Task& task)
+        {
+            // Own tasks newest first, then the oldest task of the next busy worker
+            for (size_t offset = 0; offset < m_Workers.size(); ++offset)
+            {
+                Worker&                     worker = *m_Workers[(index + offset) % m_Workers.size()];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if (worker.tasks.empty())
+                    continue;
+
+                if (offset == 0)
+                {
+                    task = std::move(worker.tasks.front());
+                    worker.tasks.pop_front();
+                }
+                else
+                {
+                    task = std::move(worker.tasks.back());
+                    worker.tasks.pop_back();
+                }
+                return true;
+            }
+            return false;
+        }
+
+        void TaskPool::workerLoop(size_t index)
+        {
+            t_TaskPool    = this;
+            t_WorkerIndex = index;
+
+            while (true)
+            {
+                Task task;
+                if (!takeTask(index, task))
+                {
+                    // A submit counts the task before pushing it, so a worker may find it missing for a moment
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_TaskAdded.wait(lock, [this] { return m_Stopping || m_Queued > 0; });
+                    if (m_Stopping && m_Queued == 0)
+                        return;
+                    continue;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    --m_Queued;
+                }
+
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    if (!m_Error)
+                        m_Error = std::current_exception();
+                }
+
+                // Release what the task captured before it counts as done
+                task = nullptr;
+
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (--m_Unfinished == 0)
+                    m_AllDone.notify_all();
+            }
+        }
+    } // namespace pipeline
+
+    namespace hunter
+    {
+        void CarvedData::append(const SharedBuffer& buffer, size_t offset, size_t size)
+        {
+            if (size == 0)
+                return;
+
+            if (!m_Segments.empty())
+            {
+                ByteView& last = m_Segments.back();
+                if (last.buffer == buffer && last.offset + last.size == offset)
+                {
+                    last.size += size;
+                    m_Size += size;
+                    return;
+                }
+            }
+
+            m_Segments.push_back({buffer, offset, size});
+            m_Size += size;
+        }
+
+        void CarvedData::clear()
+        {
+            m_Segments.clear();
+            m_Size = 0;
+        }
+
+        std::vector<char> CarvedData::toVector() const
+        {
+            stats::add(stats::Counter::BytesCopied, m_Size);
+
+            std::vector<char> bytes;
+            bytes.reserve(m_Size);
+            for (const auto& segment : m_Segments)
+                bytes.insert(bytes.end(), segment.data(), segment.data() + segment.size);
+            return bytes;
+        }
+
+        void CarvedData::writeTo(std::ostream& stream) const
+        {
+            for (const auto& segment : m_Segments)
+                stream.write(segment.data(), static_cast<std::streamsize>(segment.size));
+        }
+
+        uint64_t CarvedData::contentHash() const
+        {
+            Xxh64 hash;
+            for (const auto& segment : m_Segments)
+                hash.update(reinterpret_cast<const unsigned char*>(segment.data()), segment.size);
+            return hash.digest();
+        }
+
+        OutputSink::OutputSink(bool async, size_t memoryLimit) :
+            m_Async(async), m_MemoryLimit(std::max<size_t>(memoryLimit, 1))
+        {
+            if (m_Async)
+                m_Writer = std::thread([this] { writerLoop(); });
+        }
+
+        OutputSink::~OutputSink() { shutdown(); }
+
+        void OutputSink::shutdown()
+        {
+            // Queued writes are still stored before the writer leaves
+            if (!m_Writer.joinable())
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_NotEmpty.notify_all();
+            m_Writer.join();
+        }
+
+        void OutputSink::write(const std::filesystem::path& path, CarvedData data)
+        {
+            if (!m_Async)
+            {
+                storeCounted(path, data);
+                return;
+            }
+
+            // Wait for room like BoundedQueue does, a file bigger than the limit gets in once nothing is pending
+            size_t                       size = data.size();
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_NotFull.wait(lock, [&] { return m_PendingBytes == 0 || m_PendingBytes + size <= m_MemoryLimit; });
+
+            m_Pending.emplace_back(path, std::move(data));
+            m_PendingBytes += size;
+            m_NotEmpty.notify_one();
+        }
+
+        void OutputSink::finish()
+        {
+            if (m_Async)
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Drained.wait(lock, [this] { return m_Pending.empty() && !m_Writing; });
+            }
+
+            finalize();
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Error)
+                std::rethrow_exception(std::exchange(m_Error, nullptr));
+        }
+
+        void OutputSink::storeCounted(const std::filesystem::path& path, const CarvedData& data)
+        {
+            stats::ScopedTimer timer(stats::Counter::WriteNanos);
+            store(path, data);
+            stats::add(stats::Counter::FilesWritten, 1);
+            stats::add(stats::Counter::BytesWritten, data.size());
+        }
+
+        void OutputSink::writerLoop()
+        {
+            while (true)
+            {
+                // Take everything queued so far in one go
+                std::deque<std::pair<std::filesystem::path, CarvedData>> batch;
+                {
+                    std::unique_lock<std::mutex> lock(m_Mutex);
+                    m_NotEmpty.wait(lock, [this] { return m_Stopping || !m_Pending.empty(); });
+                    if (m_Pending.empty())
+                        return;
+
+                    batch.swap(m_Pending);
+                    m_Writing = true;
+                }
+
+                for (auto& [path, data] : batch)
+                {
+                    size_t size = data.size();
+                    try
+                    {
+                        storeCounted(path, data);
+                    }
+                    catch (...)
+                    {
+                        // Reported by store, the other files are still written
+                        std::lock_guard<std::mutex> lock(m_Mutex);
+                        if (!m_Error)
+                            m_Error = std::current_exception();
+                    }
+                    data.clear(); // Let go of the source buffers before making room for more
+
+                    {
+                        std::lock_guard<std::mutex> lock(m_Mutex);
+                        m_PendingBytes -= size;
+                    }
+                    m_NotFull.notify_all();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Writing = false;
+                }
+                m_Drained.notify_all();
+            }
+        }
+
+        DirectorySink::DirectorySink(bool async, size_t memoryLimit) : OutputSink(async, memoryLimit) {}
+
+        DirectorySink::~DirectorySink() { shutdown(); }
+
+        void DirectorySink::store(const std::filesystem::path& path, const CarvedData& data)
+        {
+            // Most files go to a directory that exists already, so it is only created when the open fails
+            std::ofstream outputFile(path, std::ios::binary);
+            if (!outputFile && path.has_parent_path())
+            {
+                std::error_code error;
+                std::filesystem::create_directories(path.parent_path(), error);
+                outputFile.open(path, std::ios::binary);
+            }
+
+            if (!outputFile)
+            {
+                std::cerr << "Error: Failed to open file for writing: " << path << std::endl;
+                throw std::runtime_error("Failed to open file for writing.");
+            }
+
+            data.writeTo(outputFile);
+            outputFile.close();
+            if (!outputFile)
+            {
+                std::cerr << "Error: Failed to write data to file: " << path << std::endl;
+                throw std::runtime_error("Failed to write data to file.");
+            }
+        }
+
+        PackedSink::PackedSink(const std::string& archivePath, const std::string& basePath, size_t memoryLimit) :
+            OutputSink(true, memoryLimit), m_ArchivePath(archivePath), m_BasePath(basePath)
+        {
+            std::filesystem::path archive(archivePath);
+            if (archive.has_parent_path())
+                std::filesystem::create_directories(archive.parent_path());
+
+            m_Archive.open(archive, std::ios::binary | std::ios::trunc);
+            if (!m_Archive)
+            {
+                std::cerr << "Error: Failed to open file for writing: " << archivePath << std::endl;
+                throw std::runtime_error("Failed to open file for writing.");
+            }
+        }
+
+        std::string PackedSink::entryName(const std::filesystem::path& path) const
+        {
+            // Paths outside the base keep their own relative form
+            std::filesystem::path relative = m_BasePath.empty() ? path : path.lexically_relative(m_BasePath);
+            if (relative.empty() || *relative.begin() == "..")
+                relative = path;
+            return relative.relative_path().lexically_normal().generic_string();
+        }
+
+        ZipSink::ZipSink(const std::string& archivePath, const std::string& basePath, size_t memoryLimit) :
+            PackedSink(archivePath, basePath, memoryLimit)
+        {}
+
+        ZipSink::~ZipSink() { shutdown(); }
+
+        void ZipSink::store(const std::filesystem::path& path, const CarvedData& data)
+        {
+            constexpr uint32_t MAX_32      = 0xFFFFFFFF;
+            constexpr uint16_t UTF8_NAMES  = 0x0800;
+            constexpr uint16_t DOS_1980_01 = 0x0021; // Entries carry no timestamp, 1980-01-01 is the zip epoch
+
+            Entry entry {entryName(path), 0, data.size(), m_Offset};
+            for (const auto& segment : data.getSegments())
+            {
+                entry.crc =
+                    crc32Update(entry.crc, reinterpret_cast<const unsigned char*>(segment.data()), segment.size);
+            }
+
+            // Local file header, sizes move to a zip64 extra field when they do not fit 32 bits
+            bool zip64 = entry.size >= MAX_32;
+            writeIntLE(m_Archive, 0x04034b50, 4);
+            writeIntLE(m_Archive, zip64 ? 45 : 20, 2); // Version needed
+            writeIntLE(m_Archive, UTF8_NAMES, 2);
+            writeIntLE(m_Archive, 0, 2); // Stored
+            writeIntLE(m_Archive, 0, 2); // Time
+            writeIntLE(m_Archive, DOS_1980_01, 2);
+            writeIntLE(m_Archive, entry.crc, 4);
+            writeIntLE(m_Archive, zip64 ? MAX_32 : entry.size, 4);
+            writeIntLE(m_Archive, zip64 ? MAX_32 : entry.size, 4);
+            writeIntLE(m_Archive, entry.name.size(), 2);
+            writeIntLE(m_Archive, zip64 ? 20 : 0, 2);
+            m_Archive.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+            if (zip64)
+            {
+                writeIntLE(m_Archive, 0x0001, 2);
+                writeIntLE(m_Archive, 16, 2);
+                writeIntLE(m_Archive, entry.size, 8);
+                writeIntLE(m_Archive, entry.size, 8);
+            }
+            data.writeTo(m_Archive);
+
+            if (!m_Archive)
+            {
+                std::cerr << "Error: Failed to write to archive: " << m_ArchivePath << std::endl;
+                throw std::runtime_error("Failed to write to archive.");
+            }
+
+            m_Offset += 30 + entry.name.size() + (zip64 ? 20 : 0) + entry.size;
+            m_Entries.push_back(std::move(entry));
+        }
+
+        void ZipSink::finalize()
+        {
+            constexpr uint32_t MAX_32 = 0xFFFFFFFF;
+            constexpr uint16_t MAX_16 = 0xFFFF;
+
+            // Central directory, with zip64 extra fields for whatever does not fit 32 bits
+            uint64_t directoryOffset = m_Offset;
+            for (const auto& entry : m_Entries)
+            {
+                bool     bigSize   = entry.size >= MAX_32;
+                bool     bigOffset = entry.offset >= MAX_32;
+                uint16_t extraSize = (bigSize ? 16 : 0) + (bigOffset ? 8 : 0);
+
+                writeIntLE(m_Archive, 0x02014b50, 4);
+                writeIntLE(m_Archive, 45, 2);                              // Version made by
+                writeIntLE(m_Archive, bigSize || bigOffset ? 45 : 20, 2); // Version needed
+                writeIntLE(m_Archive, 0x0800, 2);
+                writeIntLE(m_Archive, 0, 2);
+                writeIntLE(m_Archive, 0, 2);
+                writeIntLE(m_Archive, 0x0021, 2);
+                writeIntLE(m_Archive, entry.crc, 4);
+                writeIntLE(m_Archive, bigSize ? MAX_32 : entry.size, 4);
+                writeIntLE(m_Archive, bigSize ? MAX_32 : entry.size, 4);
+                writeIntLE(m_Archive, entry.name.size(), 2);
+                writeIntLE(m_Archive, extraSize > 0 ? extraSize + 4 : 0, 2);
+                writeIntLE(m_Archive, 0, 2); // Comment length
+                writeIntLE(m_Archive, 0, 2); // Disk
+                writeIntLE(m_Archive, 0, 2); // Internal attributes
+                writeIntLE(m_Archive, 0, 4); // External attributes
+                writeIntLE(m_Archive, bigOffset ? MAX_32 : entry.offset, 4);
+                m_Archive.write(entry.name.data(), static_cast<std::streamsize>(entry.name.size()));
+                if (extraSize > 0)
+                {
+                    writeIntLE(m_Archive, 0x0001, 2);
+                    writeIntLE(m_Archive, extraSize, 2);
+                    if (bigSize)
+                    {
+                        writeIntLE(m_Archive, entry.size, 8);
+                        writeIntLE(m_Archive, entry.size, 8);
+                    }
+                    if (bigOffset)
+                        writeIntLE(m_Archive, entry.offset, 8);
+                }
+                m_Offset += 46 + entry.name.size() + (extraSize > 0 ? extraSize + 4 : 0);
+            }
+            uint64_t directorySize = m_Offset - directoryOffset;
+
+            // Zip64 end of central directory record and locator, only when the plain record can not hold it all
+            if (m_Entries.size() >= MAX_16 || directoryOffset >= MAX_32 || directorySize >= MAX_32)
+            {
+                uint64_t recordOffset = m_Offset;
+                writeIntLE(m_Archive, 0x06064b50, 4);
+                writeIntLE(m_Archive, 44, 8); // Size of the rest of the record
+                writeIntLE(m_Archive, 45, 2);
+                writeIntLE(m_Archive, 45, 2);
+                writeIntLE(m_Archive, 0, 4);
+                writeIntLE(m_Archive, 0, 4);
+                writeIntLE(m_Archive, m_Entries.size(), 8);
+                writeIntLE(m_Archive, m_Entries.size(), 8);
+                writeIntLE(m_Archive, directorySize, 8);
+                writeIntLE(m_Archive, directoryOffset, 8);
+
+                writeIntLE(m_Archive, 0x07064b50, 4);
+                writeIntLE(m_Archive, 0, 4);
+                writeIntLE(m_Archive, recordOffset, 8);
+                writeIntLE(m_Archive, 1, 4);
+            }
+
+            writeIntLE(m_Archive, 0x06054b50, 4);
+            writeIntLE(m_Archive, 0, 2);
+            writeIntLE(m_Archive, 0, 2);
+            writeIntLE(m_Archive, std::min<uint64_t>(m_Entries.size(), MAX_16), 2);
+            writeIntLE(m_Archive, std::min<uint64_t>(m_Entries.size(), MAX_16), 2);
+            writeIntLE(m_Archive, std::min<uint64_t>(directorySize, MAX_32), 4);
+            writeIntLE(m_Archive, std::min<uint64_t>(directoryOffset, MAX_32), 4);
+            writeIntLE(m_Archive, 0, 2);
+
+            m_Archive.close();
+            if (!m_Archive)
+            {
+                std::cerr << "Error: Failed to write to archive: " << m_ArchivePath << std::endl;
+                throw std::runtime_error("Failed to write to archive.");
+            }
+        }
+
+        TarSink::TarSink(const std::string& archivePath, const std::string& basePath, size_t memoryLimit) :
+            PackedSink(archivePath, basePath, memoryLimit)
+        {}
+
+        TarSink::~TarSink() { shutdown(); }
+
+        void TarSink::store(const std::filesystem::path& path, const CarvedData& data)
+        {
+            writeHeader(entryName(path), data.size(), '0');
+            data.writeTo(m_Archive);
+            pad(data.size());
+
+            if (!m_Archive)
+            {
+                std::cerr << "Error: Failed to write to archive: " << m_ArchivePath << std::endl;
+                throw std::runtime_error("Failed to write to archive.");
+            }
+        }
+
+        void TarSink::finalize()
+        {
+            // Two zero blocks end the archive
+            std::array<char, 1024> end {};
+            m_Archive.write(end.data(), end.size());
+            m_Archive.close();
+            if (!m_Archive)
+            {
+                std::cerr << "Error: Failed to write to archive: " << m_ArchivePath << std::endl;
+                throw std::runtime_error("Failed to write to archive.");
+            }
+        }
+
+        void TarSink::writeHeader(const std::string& name, uint64_t size, char type)
+        {
+            std::array<char, 512> header {};
+            auto putOctal = [&header](size_t offset, size_t width, uint64_t value) {
+                // width - 1 digits and a terminating NUL
+                for (size_t i = width - 1; i-- > 0; value >>= 3)
+                    header[offset + i] = static_cast<char>('0' + (value & 7));
+            };
+
+            // Names up to 100 bytes fit the name field, up to 256 when split into prefix and name at a slash.
+            // Anything longer goes in a GNU long name entry right before this one
+            std::string_view nameField = name;
+            std::string_view prefix;
+            if (name.size() > 100)
+            {
+                size_t slash = name.find('/', name.size() - std::min<size_t>(name.size(), 101));
+                if (slash != std::string::npos && slash <= 155 && slash > 0)
+                {
+                    prefix    = std::string_view(name).substr(0, slash);
+                    nameField = std::string_view(name).substr(slash + 1);
+                }
+                else
+                {
+                    writeHeader("././@LongLink", name.size() + 1, 'L');
+                    m_Archive.write(name.c_str(), static_cast<std::streamsize>(name.size() + 1));
+                    pad(name.size() + 1);
+                    nameField = std::string_view(name).substr(0, 100);
+                }
+            }
+
+            std::memcpy(&header[0], nameField.data(), nameField.size());
+            putOctal(100, 8, 0644); // Mode
+            putOctal(108, 8, 0);    // Owner
+            putOctal(116, 8, 0);    // Group
+            if (size < (uint64_t(1) << 33))
+            {
+                putOctal(124, 12, size);
+            }
+            else
+            {
+                // Base-256: a set high bit, then the size big-endian
+                header[124] = static_cast<char>(0x80);
+                for (size_t i = 0; i < 8; ++i)
+                    header[135 - i] = static_cast<char>(size >> (8 * i));
+            }
+            putOctal(136, 12, 0); // Modification time
+            header[156] = type;
+            std::memcpy(&header[257], "ustar", 6);
+            std::memcpy(&header[263], "00", 2);
+            std::memcpy(&header[345], prefix.data(), prefix.size());
+
+            // The checksum is taken with its own field as spaces
+            std::memset(&header[148], ' ', 8);
+            uint32_t checksum = 0;
+            for (char c : header)
+                checksum += static_cast<unsigned char>(c);
+            putOctal(148, 7, checksum);
+
+            m_Archive.write(header.data(), header.size());
+            m_Offset += header.size();
+        }
+
+        void TarSink::pad(uint64_t size)
+        {
+            std::array<char, 512> zeros {};
+            size_t                padding = (512 - size % 512) % 512;
+            m_Archive.write(zeros.data(), static_cast<std::streamsize>(padding));
+            m_Offset += size + padding;
+        }
+
+        std::optional<std::filesystem::path> AssetDedup::claim(uint64_t                     hash,
+                                                               size_t                       size,
+                                                               const std::filesystem::path& path)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            // Same hash and size is taken as same content, a 64-bit hash makes a collision practically impossible
+            auto& originals = m_Originals[hash];
+            for (const auto& original : originals)
+            {
+                if (original.size == size)
+                {
+                    m_References.emplace_back(path, original.path);
+                    m_ReferencePaths.insert(path.generic_string());
+                    ++m_DuplicateCount;
+                    return original.path;
+                }
+            }
+
+            originals.push_back({size, path});
+            return std::nullopt;
+        }
+
+        void AssetDedup::addOriginal(uint64_t hash, size_t size, const std::filesystem::path& path)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            auto& originals = m_Originals[hash];
+            for (const auto& original : originals)
+            {
+                if (original.size == size)
+                    return;
+            }
+            originals.push_back({size, path});
+        }
+
+        void AssetDedup::addReference(const std::filesystem::path& path, const std::filesystem::path& original)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_References.emplace_back(path, original);
+            m_ReferencePaths.insert(path.generic_string());
+        }
+
+        bool AssetDedup::isDuplicate(const std::filesystem::path& path) const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_ReferencePaths.count(path.generic_string()) > 0;
+        }
+
+        void AssetDedup::writeManifests() const
+        {
+            DirectorySink sink(false);
+            writeManifests(sink);
+        }
+
+        void AssetDedup::writeManifests(OutputSink& sink) const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            // Group the references by the directory the duplicate would have been saved to
+            std::map<std::filesystem::path, std::vector<const Reference*>> directories;
+            for (const auto& reference : m_References)
+                directories[reference.first.parent_path()].push_back(&reference);
+
+            for (const auto& [dir, references] : directories)
+            {
+                std::string manifest;
+                for (const auto* reference : references)
+                {
+                    manifest += reference->first.filename().generic_string() + '\t' +
+                                reference->second.lexically_relative(dir).generic_string() + '\n';
+                }
+
+                CarvedData data;
+                data.append(makeSharedBuffer(io::Buffer(manifest.begin(), manifest.end())), 0, manifest.size());
+                sink.write(dir / "duplicates.tsv", std::move(data));
+            }
+        }
+
+        size_t AssetDedup::getDuplicateCount() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_DuplicateCount;
+        }
+
+        ResultCache::ResultCache(const std::string& cachePath, uint64_t settingsKey) :
+            m_CachePath(cachePath), m_SettingsKey(settingsKey)
+        {
+            std::ifstream file(m_CachePath, std::ios::binary);
+            if (!file)
+                return; // First run
+
+            try
+            {
+                std::string magic(CACHE_MAGIC.size(), '\0');
+                file.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+                if (!file || magic != CACHE_MAGIC || readIntLE(file, 8) != m_SettingsKey)
+                    return; // Another format or other settings, everything is hunted again
+
+                uint64_t jarCount = readIntLE(file, 4);
+                for (uint64_t i = 0; i < jarCount; ++i)
+                {
+                    JarRecord record;
+                    record.jarPath     = readCacheString(file);
+                    record.fingerprint = readIntLE(file, 8);
+                    record.outPath     = readCacheString(file);
+
+                    uint64_t assetCount = readIntLE(file, 4);
+                    for (uint64_t j = 0; j < assetCount; ++j)
+                    {
+                        Asset asset;
+                        asset.type     = static_cast<AssetType>(readIntLE(file, 1));
+                        asset.hash     = readIntLE(file, 8);
+                        asset.size     = readIntLE(file, 8);
+                        asset.fileName = readCacheString(file);
+                        asset.hasWAV   = readIntLE(file, 1) != 0;
+                        record.assets.push_back(std::move(asset));
+                    }
+
+                    for (const auto& asset : record.assets)
+                    {
+                        if (asset.type == AssetType::MIDI && asset.hasWAV)
+                        {
+                            auto wavPath = std::filesystem::path(record.outPath) / asset.fileName;
+                            wavPath.replace_extension(".wav");
+                            m_Renders.try_emplace(asset.hash, asset.size, wavPath.string());
+                        }
+                    }
+                    m_Jars[record.jarPath] = std::move(record);
+                }
+            }
+            catch (const std::runtime_error& error)
+            {
+                // A damaged cache only costs a full run
+                std::cerr << "Warning: Ignoring cache file " << m_CachePath << ": " << error.what() << std::endl;
+                m_Jars.clear();
+                m_Renders.clear();
+            }
+        }
+
+        uint64_t ResultCache::makeSettingsKey(std::string_view settings)
+        {
+            Xxh64 hash;
+            hash.update(reinterpret_cast<const unsigned char*>(settings.data()), settings.size());
+            return hash.digest();
+        }
+
+        std::optional<ResultCache::JarRecord> ResultCache::findJar(const std::string& jarPath,
+                                                                   uint64_t           fingerprint,
+                                                                   const std::string& outPath) const
+        {
+            JarRecord record;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                auto                        it = m_Jars.find(jarPath);
+                if (it == m_Jars.end() || it->second.fingerprint != fingerprint || it->second.outPath != outPath)
+                    return std::nullopt;
+                record = it->second;
+            }
+
+            // Outputs deleted since then are produced again
+            std::filesystem::path dir(outPath);
+            for (const auto& asset : record.assets)
+            {
+                std::error_code error;
+                if (!std::filesystem::exists(dir / asset.fileName, error))
+                    return std::nullopt;
+                if (asset.hasWAV && !std::filesystem::exists((dir / asset.fileName).replace_extension(".wav"), error))
+                    return std::nullopt;
+            }
+            return record;
+        }
+
+        void ResultCache::storeJar(JarRecord record)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jars[record.jarPath] = std::move(record);
+            m_Changed              = true;
+        }
+
+        std::optional<std::filesystem::path> ResultCache::findRender(uint64_t hash, uint64_t size) const
+        {
+            std::filesystem::path wavPath;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                auto                        it = m_Renders.find(hash);
+                if (it == m_Renders.end() || it->second.first != size)
+                    return std::nullopt;
+                wavPath = it->second.second;
+            }
+
+            std::error_code error;
+            if (!std::filesystem::is_regular_file(wavPath, error))
+                return std::nullopt;
+            return wavPath;
+        }
+
+        void ResultCache::save() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (!m_Changed)
+                return;
+
+            // Written next to the old file and renamed over it, so an interrupted run leaves the old cache intact
+            std::string   tempPath = m_CachePath + ".tmp";
+            std::ofstream file(tempPath, std::ios::binary);
+            if (!file)
+            {
+                std::cerr << "Error: Failed to open file for writing: " << tempPath << std::endl;
+                throw std::runtime_error("Failed to open file for writing.");
+            }
+
+            file.write(CACHE_MAGIC.data(), static_cast<std::streamsize>(CACHE_MAGIC.size()));
+            writeIntLE(file, m_SettingsKey, 8);
+            writeIntLE(file, m_Jars.size(), 4);
+            for (const auto& [jarPath, record] : m_Jars)
+            {
+                writeCacheString(file, record.jarPath);
+                writeIntLE(file, record.fingerprint, 8);
+                writeCacheString(file, record.outPath);
+                writeIntLE(file, record.assets.size(), 4);
+                for (const auto& asset : record.assets)
+                {
+                    writeIntLE(file, static_cast<uint8_t>(asset.type), 1);
+                    writeIntLE(file, asset.hash, 8);
+                    writeIntLE(file, asset.size, 8);
+                    writeCacheString(file, asset.fileName);
+                    writeIntLE(file, asset.hasWAV ? 1 : 0, 1);
+                }
+            }
+
+            file.close();
+            if (!file)
+            {
+                std::cerr << "Error: Failed to write cache file: " << tempPath << std::endl;
+                throw std::runtime_error("Failed to write cache file.");
+            }
+            std::filesystem::rename(tempPath, m_CachePath);
+        }
+
+        // Find a precompiled byte pattern in a buffer starting from a given position
+        template<typename FileType>
+        size_t HunterBase<FileType>::findSequenceInBuffer(io::ByteSpan               buffer,
+                                                          const search::BytePattern& pattern,
+                                                          size_t                     startPos) const
+        {
+            // Buffers added by a fused scan already know where every signature is
+            if (!m_SourceMatches.empty() && !buffer.empty())
+            {
+                auto it = m_SourceMatches.find(buffer.data());
+                if (it != m_SourceMatches.end() && it->second.contains(pattern))
+                    return it->second.find(pattern, startPos);
+            }
+
+            return pattern.find(buffer.data(), buffer.size(), startPos);
+        }
+
+        // The PNG file signature (header)
+        const search::BytePattern MAGIC_PNG_START(std::string_view("\x89PNG\r\n\x1A\n", 8));
+
+        std::vector<const search::BytePattern*> PngHunter::getSignatures() const { return {&MAGIC_PNG_START}; }
+
+        std::vector<PngFile> PngHunter::parseFiles() const
+        {
+            std::vector<PngFile> pngFiles;
+            ParseState           state;
+
+            // Iterate through all source buffers, a PNG may continue from one buffer into the next
+            for (const auto& source : m_SourceBuffers)
+            {
+                // An embedded buffer is whole on its own, a PNG spanning two entries carries on right past it
+                if (isEmbedded(source))
+                {
+                    ParseState embeddedState;
+                    parseBuffer(source, embeddedState, pngFiles);
+                    while (embeddedState.pngStarted)
+                        rescanCarryOver(embeddedState, pngFiles);
+                    continue;
+                }
+
+                parseBuffer(source, state, pngFiles);
+            }
+
+            // A PNG still open at the end never was one
+            while (state.pngStarted)
+                rescanCarryOver(state, pngFiles);
+
+            return pngFiles;
+        }
+
+        std::vector<PngFile> PngHunter::parseNextBuffer(const SharedBuffer& buffer)
+        {
+            std::vector<PngFile> pngFiles;
+            parseBuffer(buffer, m_StreamState, pngFiles);
+            return pngFiles;
+        }
+
+        std::vector<PngFile> PngHunter::parseStandaloneBuffer(const SharedBuffer& buffer) const
+        {
+            std::vector<PngFile> pngFiles;
+            ParseState           state;
+            parseBuffer(buffer, state, pngFiles);
+
+            // Nothing follows a standalone buffer, a PNG still open at its end never was one
+            while (state.pngStarted)
+                rescanCarryOver(state, pngFiles);
+            return pngFiles;
+        }
+
+        std::vector<PngFile> PngHunter::finishStream()
+        {
+            std::vector<PngFile> pngFiles;
+            stats::ScopedTimer   timer(stats::Counter::ParseNanos);
+            while (m_StreamState.pngStarted)
+                rescanCarryOver(m_StreamState, pngFiles);
+            return pngFiles;
+        }
+
+        void PngHunter::parseBuffer(const SharedBuffer& source, ParseState& state, std::vector<PngFile>& pngFiles) const
+        {
+            stats::ScopedTimer timer(stats::Counter::ParseNanos);
+            stats::add(stats::Counter::BytesParsed, source->size());
+            searchBuffer(source, 0, state, pngFiles);
+        }
+
+        void PngHunter::searchBuffer(const SharedBuffer&   source,
+                                     size_t                start,
+                                     ParseState&           state,
+                                     std::vector<PngFile>& pngFiles) const
+        {
+            const auto& sourceBuffer = *source;
+            size_t      bufferSize   = sourceBuffer.size();
+            size_t      i            = start;
+
+            // A PNG from the previous buffers continues at the start of this one
+            while (state.pngStarted)
+            {
+                size_t    pos  = 0;
+                ChunkWalk walk = walkChunks(sourceBuffer, pos, state);
+                if (walk == ChunkWalk::NeedMore && state.currentPng.size() + bufferSize > m_Settings.maxSpanSize)
+                    walk = ChunkWalk::Invalid; // No PNG reaches this far
+
+                if (walk == ChunkWalk::Complete)
+                {
+                    state.currentPng.append(source, 0, pos);
+                    pngFiles.push_back(makeCarvedFile<PngFile>(std::move(state.currentPng)));
+                    stats::add(stats::Counter::PngsCarved, 1);
+                    state = {};
+                    i     = pos;
+                    break;
+                }
+                if (walk == ChunkWalk::NeedMore)
+                {
+                    state.currentPng.append(source, 0, bufferSize);
+                    return;
+                }
+
+                // A PNG found in the buffers searched again may carry over into this one, which is walked again then.
+                // Otherwise this buffer is searched from its start
+                rescanCarryOver(state, pngFiles);
+            }
+
+            while (i < bufferSize)
+            {
+                // Look for the start of a PNG file
+                size_t startPos = findSequenceInBuffer(sourceBuffer, MAGIC_PNG_START, i);
+                if (startPos == std::string::npos)
+                    break;
+
+                // Walk the chunks after the signature to find where the PNG ends
+                size_t pos = startPos + MAGIC_PNG_START.size();
+                state      = {};
+                stats::add(stats::Counter::SignatureMatches, 1);
+                switch (walkChunks(sourceBuffer, pos, state))
+                {
+                    case ChunkWalk::Complete:
+                        state.currentPng.append(source, startPos, pos - startPos);
+                        pngFiles.push_back(makeCarvedFile<PngFile>(std::move(state.currentPng)));
+                        stats::add(stats::Counter::PngsCarved, 1);
+                        state = {};
+                        i     = pos; // Move index past the PNG end
+                        break;
+                    case ChunkWalk::NeedMore:
+                        // The PNG runs past the end of this buffer, carry it over to the next one
+                        state.currentPng.append(source, startPos, bufferSize - startPos);
+                        state.pngStarted = true;
+                        return;
+                    case ChunkWalk::Invalid:
+                        // A false positive signature, keep searching right after it
+                        stats::add(stats::Counter::RejectedCandidates, 1);
+                        state = {};
+                        i     = startPos + 1;
+                        break;
+                }
+            }
+        }
+
+        void PngHunter::rescanCarryOver(ParseState& state, std::vector<PngFile>& pngFiles) const
+        {
+            stats::add(stats::Counter::RejectedCandidates, 1);
+
+            // The first buffer was searched up to the false signature, the ones after it not at all
+            std::vector<ByteView> skipped = state.currentPng.getSegments();
+            state                         = {};
+            for (size_t k = 0; k < skipped.size(); ++k)
+                searchBuffer(skipped[k].buffer, k == 0 ? skipped[k].offset + 1 : 0, state, pngFiles);
+        }
+
+        PngHunter::ChunkWalk PngHunter::walkChunks(io::ByteSpan buffer, size_t& pos, ParseState& state) const
+        {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+            const size_t size = buffer.size();
+
+            while (true)
+            {
+                // Chunk header: 4 bytes big-endian data length, 4 bytes type
+                while (state.headerBytes < state.chunkHeader.size())
+                {
+                    if (pos >= size)
+                        return ChunkWalk::NeedMore;
+                    state.chunkHeader[state.headerBytes++] = bytes[pos++];
+
+                    if (state.headerBytes == state.chunkHeader.size())
+                    {
+                        const auto& header = state.chunkHeader;
+                        uint32_t    length = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) |
+                                          (uint32_t(header[2]) << 8) | uint32_t(header[3]);
+
+                        // The PNG spec limits lengths to 2^31 - 1, and chunk types are 4 ASCII letters
+                        if (length > 0x7FFFFFFFu)
+                            return ChunkWalk::Invalid;
+                        for (size_t k = 4; k < 8; ++k)
+                        {
+                            if (!std::isalpha(header[k]))
+                                return ChunkWalk::Invalid;
+                        }
+
+                        // Every PNG starts with a 13 byte IHDR chunk
+                        if (state.chunkCount == 0 && (std::memcmp(&header[4], "IHDR", 4) != 0 || length != 13))
+                            return ChunkWalk::Invalid;
+
+                        state.dataRemaining = length;
+                        state.crcBytes      = 0;
+                        state.storedCRC     = 0;
+                        if (m_Settings.verifyCRC)
+                            state.runningCRC = crc32Update(0, &header[4], 4);
+                    }
+                }
+
+                // Chunk data: skipped without being read, unless it has to be checksummed
+                if (state.dataRemaining > 0)
+                {
+                    size_t available = static_cast<size_t>(std::min<uint64_t>(state.dataRemaining, size - pos));
+                    if (m_Settings.verifyCRC)
+                        state.runningCRC = crc32Update(state.runningCRC, bytes + pos, available);
+
+                    pos += available;
+                    state.dataRemaining -= available;
+                    if (state.dataRemaining > 0)
+                        return ChunkWalk::NeedMore;
+                }
+
+                // Chunk CRC: 4 bytes big-endian over the type and the data
+                while (state.crcBytes < 4)
+                {
+                    if (pos >= size)
+                        return ChunkWalk::NeedMore;
+                    state.storedCRC = (state.storedCRC << 8) | bytes[pos++];
+                    ++state.crcBytes;
+                }
+
+                if (m_Settings.verifyCRC && state.storedCRC != state.runningCRC)
+                    return ChunkWalk::Invalid;
+
+                ++state.chunkCount;
+                state.headerBytes = 0;
+
+                if (std::memcmp(&state.chunkHeader[4], "IEND", 4) == 0)
+                    return ChunkWalk::Complete;
+            }
+        }
+
+        void PngHunter::setSettings(const PngHunterSettings& settings) { m_Settings = settings; }
+
+        void PngHunter::saveFiles(const std::vector<PngFile>& pngFiles,
+                                  const std::string&          outputDir,
+                                  const std::string&          prefix) const
+        {
+            // Check if the output directory exists, if not, create it
+            if (sinkOrDirect(m_Settings.sink).isDirectory())
+                ensureOutputDirectory(outputDir);
+
+            // Iterate over all PNG files and save them
+            for (size_t i = 0; i < pngFiles.size(); ++i)
+            {
+                saveFile(pngFiles[i], outputDir, prefix, i);
+            }
+        }
+
+        void PngHunter::saveFile(const PngFile&     pngFile,
+                                 const std::string& outputDir,
+                                 const std::string& prefix,
+                                 size_t             index) const
+        {
+            // Construct the output file path with the prefix and index
+            std::string           fileName = prefix + std::to_string(index) + ".png";
+            std::filesystem::path filePath = std::filesystem::path(outputDir) / fileName;
+
+            // A PNG saved before is only referenced
+            if (m_Settings.dedup)
+            {
+                uint64_t hash = pngFile.contentHash != 0 ? pngFile.contentHash : pngFile.data.contentHash();
+                if (auto original = m_Settings.dedup->claim(hash, pngFile.data.size(), filePath))
+                {
+                    if (!m_Settings.quiet)
+                    {
+                        std::ostringstream message;
+                        message << "PNG file skipped: " << filePath << " duplicates " << *original << '\n';
+                        std::cout << message.str() << std::flush;
+                    }
+                    return;
+                }
+            }
+
+            // Hand the PNG data to the sink, which may write it later on its own thread
+            sinkOrDirect(m_Settings.sink).write(filePath, pngFile.data);
+
+            if (m_Settings.quiet)
+                return;
+
+            // Formatted first and written at once, files may be saved from several threads
+            std::ostringstream message;
+            message << "PNG file saved: " << filePath << '\n';
+            std::cout << message.str();
+        }
+
+        const search::BytePattern MAGIC_MIDI_HEADER(std::string_view("MThd", 4));
+
+        std::vector<const search::BytePattern*> MidiHunter::getSignatures() const { return {&MAGIC_MIDI_HEADER}; }
+
+        std::vector<MidiFile> MidiHunter::parseFiles() const
+        {
+            std::vector<MidiFile> midiFiles;
+
+            ParseState            state;
+
+            // Iterate through each buffer in the source buffers, a MIDI may continue from one buffer into the next
+            for (const auto& source : m_SourceBuffers)
+            {
+                // An embedded buffer is whole on its own, a MIDI spanning two entries carries on right past it
+                if (isEmbedded(source))
+                {
+                    ParseState embeddedState;
+                    parseBuffer(source, embeddedState, midiFiles);
+                    while (embeddedState.midiStarted)
+                        rescanCarryOver(embeddedState, midiFiles);
+                    continue;
+                }
+
+                parseBuffer(source, state, midiFiles);
+            }
+
+            // A MIDI still open at the end never was one
+            while (state.midiStarted)
+                rescanCarryOver(state, midiFiles);
+
+            return midiFiles;
+        }
+
+        std::vector<MidiFile> MidiHunter::parseStandaloneBuffer(const SharedBuffer& buffer) const
+        {
+            std::vector<MidiFile> midiFiles;
+            ParseState            state;
+            parseBuffer(buffer, state, midiFiles);
+
+            // Nothing follows a standalone buffer, a MIDI still open at its end never was one
+            while (state.midiStarted)
+                rescanCarryOver(state, midiFiles);
+            return midiFiles;
+        }
+
+        std::vector<MidiFile> MidiHunter::finishStream()
+        {
+            std::vector<MidiFile> midiFiles;
+            stats::ScopedTimer    timer(stats::Counter::ParseNanos);
+            while (m_StreamState.midiStarted)
+                rescanCarryOver(m_StreamState, midiFiles);
+            return midiFiles;
+        }
+
+        std::vector<MidiFile> MidiHunter::parseNextBuffer(const SharedBuffer& buffer)
+        {
+            std::vector<MidiFile> midiFiles;
+            parseBuffer(buffer, m_StreamState, midiFiles);
+            return midiFiles;
+        }
+
+        void MidiHunter::parseBuffer(const SharedBuffer& source, ParseState& state, std::vector<MidiFile>& midiFiles) const
+        {
+            stats::ScopedTimer timer(stats::Counter::ParseNanos);
+            stats::add(stats::Counter::BytesParsed, source->size());
+            searchBuffer(source, 0, state, midiFiles);
+        }
+
+        void MidiHunter::searchBuffer(const SharedBuffer&    source,
+                                      size_t                 start,
+                                      ParseState&            state,
+                                      std::vector<MidiFile>& midiFiles) const
+        {
+            const auto& buffer    = *source;
+            size_t      searchPos = start; // Start position for searching in the current buffer
+
+            // A MIDI from the previous buffers continues at the start of this one
+            while (state.midiStarted)
+            {
+                size_t    pos  = 0;
+                ChunkWalk walk = walkChunks(buffer, pos, state);
+                if (walk == ChunkWalk::NeedMore && state.currentMidi.size() + buffer.size() > m_Settings.maxSpanSize)
+                    walk = ChunkWalk::Invalid; // No MIDI reaches this far
+
+                if (walk == ChunkWalk::Complete)
+                {
+                    state.currentMidi.append(source, 0, pos);
+                    midiFiles.push_back(makeCarvedFile<MidiFile>(std::move(state.currentMidi)));
+                    stats::add(stats::Counter::MidisCarved, 1);
+                    state     = {};
+                    searchPos = pos;
+                    break;
+                }
+                if (walk == ChunkWalk::NeedMore)
+                {
+                    state.currentMidi.append(source, 0, buffer.size());
+                    return;
+                }
+
+                // A MIDI found in the buffers searched again may carry over into this one, which is walked again
+                // then. Otherwise this buffer is searched from its start
+                rescanCarryOver(state, midiFiles);
+            }
+
+            // Continue searching for 'MThd' until no more headers are found in the buffer
+            while (searchPos < buffer.size())
+            {
+                // Find MIDI header 'MThd'
+                size_t headerPos = findSequenceInBuffer(buffer, MAGIC_MIDI_HEADER, searchPos);
+                if (headerPos == std::string::npos)
+                {
+                    // No more MIDI headers found in this buffer, stop searching
+                    break;
+                }
+
+                // Walk the header and track chunks to find where this MIDI ends
+                size_t pos = headerPos;
+                state      = {};
+                stats::add(stats::Counter::SignatureMatches, 1);
+                switch (walkChunks(buffer, pos, state))
+                {
+                    case ChunkWalk::Complete:
+                        state.currentMidi.append(source, headerPos, pos - headerPos);
+                        midiFiles.push_back(makeCarvedFile<MidiFile>(std::move(state.currentMidi)));
+                        stats::add(stats::Counter::MidisCarved, 1);
+                        state     = {};
+                        searchPos = pos; // Move the search position past the end of this MIDI
+                        break;
+                    case ChunkWalk::NeedMore:
+                        // The MIDI runs past the end of this buffer, carry it over to the next one
+                        state.currentMidi.append(source, headerPos, buffer.size() - headerPos);
+                        state.midiStarted = true;
+                        return;
+                    case ChunkWalk::Invalid:
+                        // A malformed header, keep searching right after it
+                        stats::add(stats::Counter::RejectedCandidates, 1);
+                        state     = {};
+                        searchPos = headerPos + MAGIC_MIDI_HEADER.size();
+                        break;
+                }
+            }
+        }
+
+        void MidiHunter::rescanCarryOver(ParseState& state, std::vector<MidiFile>& midiFiles) const
+        {
+            stats::add(stats::Counter::RejectedCandidates, 1);
+
+            // The first buffer was searched up to the false header, the ones after it not at all
+            std::vector<ByteView> skipped = state.currentMidi.getSegments();
+            state                         = {};
+            for (size_t k = 0; k < skipped.size(); ++k)
+            {
+                size_t start = k == 0 ? skipped[k].offset + MAGIC_MIDI_HEADER.size() : 0;
+                searchBuffer(skipped[k].buffer, start, state, midiFiles);
+            }
+        }
+
+        MidiHunter::ChunkWalk MidiHunter::walkChunks(io::ByteSpan buffer, size_t& pos, ParseState& state) const
+        {
+            const auto*  bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+            const size_t size  = buffer.size();
+
+            while (true)
+            {
+                // Chunk header: 4 bytes type, 4 bytes big-endian data length
+                while (state.headerBytes < state.chunkHeader.size())
+                {
+                    if (pos >= size)
+                        return ChunkWalk::NeedMore;
+                    state.chunkHeader[state.headerBytes++] = bytes[pos++];
+
+                    if (state.headerBytes == state.chunkHeader.size())
+                    {
+                        const auto& header = state.chunkHeader;
+                        for (size_t k = 0; k < 4; ++k)
+                        {
+                            if (!std::isalpha(header[k]))
+                                return ChunkWalk::Invalid;
+                        }
+
+                        // The MThd chunk holds at least format, track count and division
+                        uint32_t length = (uint32_t(header[4]) << 24) | (uint32_t(header[5]) << 16) |
+                                          (uint32_t(header[6]) << 8) | uint32_t(header[7]);
+                        if (state.chunkCount == 0 && length < state.midiHeader.size())
+                            return ChunkWalk::Invalid;
+
+                        state.dataRemaining = length;
+                        state.dataRead      = 0;
+                    }
+                }
+
+                // Chunk data: only the MThd fields are read, track data is skipped
+                if (state.chunkCount == 0)
+                {
+                    while (state.dataRead < state.midiHeader.size())
+                    {
+                        if (pos >= size)
+                            return ChunkWalk::NeedMore;
+                        state.midiHeader[state.dataRead++] = bytes[pos++];
+                        --state.dataRemaining;
+                    }
+                }
+
+                if (state.dataRemaining > 0)
+                {
+                    size_t available = static_cast<size_t>(std::min<uint64_t>(state.dataRemaining, size - pos));
+                    pos += available;
+                    state.dataRead += available;
+                    state.dataRemaining -= available;
+                    if (state.dataRemaining > 0)
+                        return ChunkWalk::NeedMore;
+                }
+
+                if (state.chunkCount == 0)
+                {
+                    const auto& header   = state.midiHeader;
+                    uint16_t    format   = static_cast<uint16_t>((header[0] << 8) | header[1]);
+                    uint16_t    tracks   = static_cast<uint16_t>((header[2] << 8) | header[3]);
+                    uint16_t    division = static_cast<uint16_t>((header[4] << 8) | header[5]);
+
+                    // Formats 0, 1 and 2 exist, a format 0 file has exactly one track
+                    if (format > 2 || tracks == 0 || (format == 0 && tracks != 1) || division == 0)
+                        return ChunkWalk::Invalid;
+
+                    state.tracksRemaining = tracks;
+                }
+                else if (std::memcmp(state.chunkHeader.data(), "MTrk", 4) == 0)
+                {
+                    --state.tracksRemaining;
+                }
+                else if (std::memcmp(state.chunkHeader.data(), "MThd", 4) == 0)
+                {
+                    return ChunkWalk::Invalid; // Another file starts before this one has all its tracks
+                }
+
+                ++state.chunkCount;
+                state.headerBytes = 0;
+
+                // Unknown chunk types are allowed between tracks and skipped, they do not count as tracks
+                if (state.tracksRemaining == 0)
+                    return ChunkWalk::Complete;
+            }
+        }
+
+        SynthPool::SynthPool(const std::string& soundFontPath, size_t size, const SynthSettings& settings) :
+            m_SoundFontPath(soundFontPath), m_Size(std::max<size_t>(size, 1)), m_Synth(settings)
+        {
+            // Initialize FluidSynth settings, shared by every synth of the pool
+            m_Settings = new_fluid_settings();
+            fluid_settings_setnum(m_Settings, "synth.sample-rate", m_Synth.sampleRate);
+            fluid_settings_setint(m_Settings, "synth.polyphony", m_Synth.polyphony);
 
-    namespace io
-    {
-        ZipArchive::ZipArchive(const std::string& zipPath)
+            // Load the SoundFont once into a synth that is never rendered with, the pooled synths only reference it
+            m_Loader = new_fluid_synth(m_Settings);
+            int id   = fluid_synth_sfload(m_Loader, m_SoundFontPath.c_str(), 1);
+            if (id == FLUID_FAILED || (m_SoundFont = fluid_synth_get_sfont_by_id(m_Loader, id)) == nullptr)
+            {
+                delete_fluid_synth(m_Loader);
+                delete_fluid_settings(m_Settings);
+                std::cerr << "Error: Failed to load SoundFont: " << m_SoundFontPath << std::endl;
+                throw std::runtime_error("Failed to load SoundFont.");
+            }
+
+            m_IdleSynths.reserve(m_Size);
+            for (size_t i = 0; i < m_Size; ++i)
+                m_IdleSynths.push_back(createSynth());
+        }
+
+        SynthPool::~SynthPool()
+        {
+            // Synths still handed out at this point are leaked rather than left with a dangling SoundFont
+            for (fluid_synth_t* synth : m_IdleSynths)
+                destroySynth(synth);
+            delete_fluid_synth(m_Loader);
+            delete_fluid_settings(m_Settings);
+        }
+
+        fluid_synth_t* SynthPool::acquire()
         {
-            int error;
-            m_ZipHandle = std::unique_ptr<zip_t, ZipDeleter>(zip_open(zipPath.c_str(), 0, &error));
-            if (!m_ZipHandle)
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_SynthReleased.wait(lock, [this] { return !m_IdleSynths.empty(); });
+
+            fluid_synth_t* synth = m_IdleSynths.back();
+            m_IdleSynths.pop_back();
+            return synth;
+        }
+
+        void SynthPool::release(fluid_synth_t* synth)
+        {
+            // A used synth keeps voices, effect tails and dither position around, so it is swapped for a fresh one
+            // to make the next render identical to one done with a brand new synth
+            destroySynth(synth);
+            fluid_synth_t* freshSynth = createSynth();
+
             {
-                std::cerr << "Error opening zip file: " << zipPath << " (Error code: " << error << ")" << std::endl;
-                ;
-                throw std::runtime_error("Failed to open zip file.");
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_IdleSynths.push_back(freshSynth);
             }
+            m_SynthReleased.notify_one();
         }
 
-        std::vector<std::string> ZipArchive::listEntries() const
+        fluid_synth_t* SynthPool::createSynth()
         {
-            std::vector<std::string> entries;
-            zip_int64_t              num_entries = zip_get_num_entries(m_ZipHandle.get(), 0);
-            for (zip_int64_t i = 0; i < num_entries; ++i)
+            fluid_synth_t* synth = new_fluid_synth(m_Settings);
+            fluid_synth_add_sfont(synth, m_SoundFont);
+            fluid_synth_program_reset(synth);
+            fluid_synth_set_interp_method(synth, -1, m_Synth.interpolation); // -1 for all channels
+            return synth;
+        }
+
+        void SynthPool::destroySynth(fluid_synth_t* synth)
+        {
+            // The SoundFont belongs to the loader synth, detach it so it is not freed along with this one
+            fluid_synth_remove_sfont(synth, m_SoundFont);
+            delete_fluid_synth(synth);
+        }
+
+        void MidiHunter::saveFiles(const std::vector<MidiFile>& midiFiles,
+                                   const std::string&           outputDir,
+                                   const std::string&           prefix) const
+        {
+            // Check if the output directory exists, if not, create it
+            if (getSink().isDirectory())
+                ensureOutputDirectory(outputDir);
+
+            size_t threadCount = m_Settings.renderThreads;
+            if (threadCount == 0)
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+            threadCount = std::min(threadCount, midiFiles.size());
+
+            if (!m_Settings.exportWAV || threadCount <= 1)
             {
-                const char* name = zip_get_name(m_ZipHandle.get(), i, 0);
-                if (name)
+                // Iterate over all MIDI files and save them
+                for (size_t i = 0; i < midiFiles.size(); ++i)
                 {
-                    entries.emplace_back(name);
+                    saveFile(midiFiles[i], outputDir, prefix, i);
                 }
+                return;
             }
-            return entries;
-        }
 
-        std::vector<char> ZipArchive::readFile(const std::string& fileName) const
-        {
-            struct zip_stat st;
-            zip_stat_init(&st);
-            if (zip_stat(m_ZipHandle.get(), fileName.c_str(), 0, &st) != 0)
+            // Write all MIDI files first, then render them on workers that each borrow a synth from the pool
+            std::vector<std::pair<size_t, std::filesystem::path>> renders;
+            renders.reserve(midiFiles.size());
+            for (size_t i = 0; i < midiFiles.size(); ++i)
             {
-                std::cerr << "Error getting file stat: " << fileName << std::endl;
-                throw std::runtime_error("Failed to get file stat.");
+                if (!writeMidiFile(midiFiles[i], outputDir, prefix, i))
+                    continue; // A duplicate, its WAV is rendered already
+
+                std::string           wavName = prefix + std::to_string(i) + ".wav";
+                std::filesystem::path wavPath = std::filesystem::path(outputDir) / wavName;
+                if (!reuseWAVFile(midiFiles[i], wavPath))
+                    renders.emplace_back(i, wavPath);
             }
 
-            std::unique_ptr<zip_file_t, ZipFileDeleter> file(zip_fopen(m_ZipHandle.get(), fileName.c_str(), 0));
-            if (!file)
+            std::atomic<size_t>             nextIndex {0};
+            std::vector<std::exception_ptr> errors(threadCount);
+            std::vector<std::thread>        workers;
+            workers.reserve(threadCount);
+
+            for (size_t worker = 0; worker < threadCount; ++worker)
             {
-                std::cerr << "Error opening file: " << fileName << std::endl;
-                throw std::runtime_error("Failed to open file.");
+                workers.emplace_back([&, worker] {
+                    try
+                    {
+                        for (size_t i = nextIndex++; i < renders.size(); i = nextIndex++)
+                            exportWAVFile(midiFiles[renders[i].first], renders[i].second);
+                    }
+                    catch (...)
+                    {
+                        errors[worker] = std::current_exception();
+                        nextIndex      = renders.size(); // Stop the other workers early
+                    }
+                });
             }
 
-            std::vector<char> buffer(st.size);
-            zip_fread(file.get(), buffer.data(), buffer.size());
+            for (auto& worker : workers)
+                worker.join();
 
-            return buffer;
+            for (const auto& error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
         }
-    } // namespace io
 
-    namespace hunter
-    {
-        // Find a sequence of bytes in a buffer starting from a given position
-        template<typename FileType>
-        size_t HunterBase<FileType>::findSequenceInBuffer(const std::vector<char>& buffer,
-                                                          const std::string&       seq,
-                                                          size_t                   startPos) const
+        void MidiHunter::saveFile(const MidiFile&    midiFile,
+                                  const std::string& outputDir,
+                                  const std::string& prefix,
+                                  size_t             index) const
         {
-            auto it = std::search(buffer.begin() + startPos, buffer.end(), seq.begin(), seq.end());
-            return it != buffer.end() ? std::distance(buffer.begin(), it) : std::string::npos;
-        }
+            auto filePath = writeMidiFile(midiFile, outputDir, prefix, index);
 
-        const std::string MAGIC_PNG_START = "\x89PNG\r\n\x1A\n";                // The PNG file signature (header)
-        const std::string MAGIC_PNG_END   = "\x49\x45\x4E\x44\xAE\x42\x60\x82"; // The IEND chunk (PNG end marker)
+            // If export WAV, unless the MIDI is a duplicate that was rendered before
+            if (m_Settings.exportWAV && filePath)
+            {
+                std::string           outWAVFile     = prefix + std::to_string(index) + ".wav";
+                std::filesystem::path outWAVFilePath = std::filesystem::path(outputDir) / outWAVFile;
+                if (!reuseWAVFile(midiFile, outWAVFilePath))
+                    exportWAVFile(midiFile, outWAVFilePath);
+            }
+        }
 
-        std::vector<PngFile> PngHunter::parseFiles() const
+        void MidiHunter::setSettings(const MidiHunterSettings& settings)
         {
-            std::vector<PngFile> pngFiles;
-            std::vector<char>    currentPng;         // Buffer to store ongoing PNG data
-            bool                 pngStarted = false; // Flag to track if PNG start was found
+            if ((settings.channels != 1 && settings.channels != 2) ||
+                (settings.bitsPerSample != 16 && settings.bitsPerSample != 32))
+            {
+                std::cerr << "Error: Unsupported WAV format: " << settings.channels << " channels of "
+                          << settings.bitsPerSample << " bits" << std::endl;
+                throw std::runtime_error("Unsupported WAV format.");
+            }
 
-            // Iterate through all source buffers
-            for (const auto& sourceBuffer : m_SourceBuffers)
+            std::lock_guard<std::mutex> lock(m_SynthPoolMutex);
+            m_Settings = settings;
+
+            // A pool created for an older SoundFont path or other synth settings is of no use anymore
+            if (m_OwnSynthPool)
             {
-                size_t bufferSize = sourceBuffer.size();
-                size_t i          = 0;
+                const SynthSettings& synth = m_OwnSynthPool->getSynthSettings();
+                if (m_OwnSynthPool->getSoundFontPath() != m_Settings.soundFontPath ||
+                    synth.sampleRate != m_Settings.synth.sampleRate || synth.polyphony != m_Settings.synth.polyphony ||
+                    synth.interpolation != m_Settings.synth.interpolation)
+                    m_OwnSynthPool.reset();
+            }
+            m_SynthPoolFailed = false;
+        }
+
+        std::optional<std::filesystem::path> MidiHunter::writeMidiFile(const MidiFile&    midiFile,
+                                                                       const std::string& outputDir,
+                                                                       const std::string& prefix,
+                                                                       size_t             index) const
+        {
+            // Construct the output file path with the prefix and index
+            std::filesystem::path dir(outputDir);
+            std::string           fileName = prefix + std::to_string(index) + ".mid";
+            std::filesystem::path filePath = dir / fileName;
 
-                // Traverse the buffer to search for PNG start and end markers
-                while (i < bufferSize)
+            // A MIDI saved before is only referenced, and so is its WAV
+            if (m_Settings.dedup)
+            {
+                uint64_t hash = midiFile.contentHash != 0 ? midiFile.contentHash : midiFile.data.contentHash();
+                if (auto original = m_Settings.dedup->claim(hash, midiFile.data.size(), filePath))
                 {
-                    if (!pngStarted)
+                    if (m_Settings.exportWAV)
                     {
-                        // Look for the start of a PNG file
-                        size_t startPos = findSequenceInBuffer(sourceBuffer, MAGIC_PNG_START, i);
-                        if (startPos != std::string::npos)
-                        {
-                            // Found PNG start, begin collecting data
-                            pngStarted = true;
-                            i          = startPos; // Move index to start position
-                            currentPng.insert(currentPng.end(),
-                                              sourceBuffer.begin() + i,
-                                              sourceBuffer.end()); // Add from start to end of current buffer
-                            i += MAGIC_PNG_START.size();           // Move index beyond the PNG start marker
-                        }
-                        else
-                        {
-                            // No PNG start found, check if there's a PNG end marker without a start
-                            size_t endPos = findSequenceInBuffer(sourceBuffer, MAGIC_PNG_END, i);
-                            if (endPos != std::string::npos && !currentPng.empty())
-                            {
-                                // Found PNG end without start in this buffer (part of ongoing PNG from previous buffer)
-                                currentPng.insert(currentPng.end(),
-                                                  sourceBuffer.begin(),
-                                                  sourceBuffer.begin() + endPos + MAGIC_PNG_END.size());
-                                pngFiles.emplace_back(currentPng); // Add complete PNG file to the list
-                                currentPng.clear();                // Clear buffer for next PNG
-                                i = endPos + MAGIC_PNG_END.size(); // Move index past the PNG end
-                            }
-                            else
-                            {
-                                // No PNG start or end found in this buffer, skip the buffer
-                                break;
-                            }
-                        }
+                        m_Settings.dedup->addReference(dir / (prefix + std::to_string(index) + ".wav"),
+                                                       std::filesystem::path(*original).replace_extension(".wav"));
                     }
-                    else
+
+                    if (!m_Settings.quiet)
                     {
-                        // We are in the middle of a PNG, so look for the PNG end marker
-                        size_t endPos = findSequenceInBuffer(sourceBuffer, MAGIC_PNG_END, i);
-                        if (endPos != std::string::npos)
-                        {
-                            // Found PNG end marker, complete the PNG file
-                            pngStarted = false;
-                            currentPng.insert(currentPng.end(),
-                                              sourceBuffer.begin(),
-                                              sourceBuffer.begin() + endPos + MAGIC_PNG_END.size());
-                            pngFiles.emplace_back(currentPng); // Add complete PNG file to the list
-                            currentPng.clear();                // Clear buffer for next PNG
-                            i = endPos + MAGIC_PNG_END.size(); // Move index past the PNG end marker
-                        }
-                        else
-                        {
-                            // PNG end not found, append the entire buffer to ongoing PNG data
-                            currentPng.insert(currentPng.end(), sourceBuffer.begin(), sourceBuffer.end());
-                            break; // Continue to the next buffer
-                        }
+                        std::ostringstream message;
+                        message << "MIDI file skipped: " << filePath << " duplicates " << *original << '\n';
+                        std::cout << message.str() << std::flush;
                     }
+                    return std::nullopt;
                 }
             }
 
-            return pngFiles;
+            // Hand the MIDI data to the sink, which may write it later on its own thread
+            getSink().write(filePath, midiFile.data);
+
+            // Formatted first and written at once, files may be saved from several threads
+            if (!m_Settings.quiet)
+            {
+                std::ostringstream message;
+                message << "MIDI file saved: " << filePath << '\n';
+                std::cout << message.str();
+            }
+            return filePath;
         }
 
-        void PngHunter::saveFiles(const std::vector<PngFile>& pngFiles,
-                                  const std::string&          outputDir,
-                                  const std::string&          prefix) const
+        SynthPool* MidiHunter::getSynthPool() const
         {
-            // Check if the output directory exists, if not, create it
-            std::filesystem::path dir(outputDir);
-            if (!std::filesystem::exists(dir))
+            if (m_Settings.synthPool)
+                return m_Settings.synthPool.get();
+
+            std::lock_guard<std::mutex> lock(m_SynthPoolMutex);
+            if (!m_OwnSynthPool && !m_SynthPoolFailed)
             {
-                if (!std::filesystem::create_directories(dir))
+                size_t poolSize = m_Settings.renderThreads;
+                if (poolSize == 0)
+                    poolSize = std::max(1u, std::thread::hardware_concurrency());
+
+                try
+                {
+                    m_OwnSynthPool = std::make_shared<SynthPool>(m_Settings.soundFontPath, poolSize, m_Settings.synth);
+                }
+                catch (const std::runtime_error&)
                 {
-                    std::cerr << "Error: Failed to create output directory: " << outputDir << std::endl;
-                    throw std::runtime_error("Failed to create output directory.");
+                    // Reported once by the pool, the MIDI files are still saved without their WAVs
+                    m_SynthPoolFailed = true;
                 }
             }
+            return m_OwnSynthPool.get();
+        }
 
-            // Iterate over all PNG files and save them
-            for (size_t i = 0; i < pngFiles.size(); ++i)
+        bool MidiHunter::reuseWAVFile(const MidiFile& midiFile, const std::filesystem::path& outputFileName) const
+        {
+            if (!m_Settings.cache)
+                return false;
+
+            uint64_t hash     = midiFile.contentHash != 0 ? midiFile.contentHash : midiFile.data.contentHash();
+            auto     original = m_Settings.cache->findRender(hash, midiFile.data.size());
+            if (!original)
+                return false;
+
+            // Rendering the same MIDI again into the same file gives the file that is already there
+            std::error_code error;
+            OutputSink&     sink = getSink();
+            if (!sink.isDirectory() || !std::filesystem::equivalent(*original, outputFileName, error))
             {
-                // Construct the output file path with the prefix and index
-                std::string           fileName = prefix + std::to_string(i) + ".png";
-                std::filesystem::path filePath = dir / fileName;
+                std::ifstream file(*original, std::ios::binary);
+                if (!file.is_open())
+                    return false; // Rendered after all
 
-                // Open a binary file stream for writing
-                std::ofstream outputFile(filePath, std::ios::binary);
-                if (!outputFile)
-                {
-                    std::cerr << "Error: Failed to open file for writing: " << filePath << std::endl;
-                    throw std::runtime_error("Failed to open file for writing.");
-                }
+                // Another jar may be writing the file right now, so only the bytes actually read are used
+                io::Buffer wav((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                if (file.bad() || wav.empty())
+                    return false;
 
-                // Write the PNG data to the file
-                outputFile.write(pngFiles[i].data.data(), pngFiles[i].data.size());
-                if (!outputFile)
-                {
-                    std::cerr << "Error: Failed to write PNG data to file: " << filePath << std::endl;
-                    throw std::runtime_error("Failed to write PNG data to file.");
-                }
+                CarvedData data;
+                size_t     wavSize = wav.size();
+                data.append(makeSharedBuffer(std::move(wav)), 0, wavSize);
+                sink.write(outputFileName, std::move(data));
+            }
 
-                // Close the file
-                outputFile.close();
-                std::cout << "PNG file saved: " << filePath << std::endl;
+            if (!m_Settings.quiet)
+            {
+                std::ostringstream message;
+                message << "WAV file reused: " << outputFileName << " from " << *original << '\n';
+                std::cout << message.str();
             }
+            return true;
         }
 
-        const std::string MAGIC_MIDI_HEADER = "MThd";
+        OutputSink& MidiHunter::getSink() const { return sinkOrDirect(m_Settings.sink); }
 
-        std::vector<MidiFile> MidiHunter::parseFiles() const
+        const char* getRenderLimitName(RenderLimit limit)
         {
-            std::vector<MidiFile> midiFiles;
+            switch (limit)
+            {
+                case RenderLimit::None:
+                    return "none";
+                case RenderLimit::Duration:
+                    return "duration";
+                case RenderLimit::Time:
+                    return "time";
+                case RenderLimit::Silence:
+                    return "silence";
+            }
+            return "unknown";
+        }
 
-            // Iterate through each buffer in the source buffers
-            for (const auto& buffer : m_SourceBuffers)
+        std::optional<WavRender> MidiHunter::renderWAV(const MidiFile& midiFile) const
+        {
+            SynthPool* pool = getSynthPool();
+            if (pool == nullptr)
+                return std::nullopt;
+
+            // Borrow a synth with the SoundFont already loaded, it goes back to the pool however this returns
+            struct SynthLease
+            {
+                SynthPool*     pool;
+                fluid_synth_t* synth;
+                ~SynthLease() { pool->release(synth); }
+            } lease {pool, pool->acquire()};
+            fluid_synth_t* synth      = lease.synth;
+            const int      sampleRate = pool->getSampleRate();
+
+            // Create a FluidSynth player and load the MIDI from memory, the file may not be written yet
+            std::vector<char> midiData = midiFile.data.toVector();
+            fluid_player_t*   player   = new_fluid_player(synth);
+            if (fluid_player_add_mem(player, midiData.data(), midiData.size()) == FLUID_FAILED)
             {
-                size_t searchPos = 0; // Start position for searching in the current buffer
+                std::cerr << "Error: Failed to load MIDI file." << std::endl;
+                delete_fluid_player(player);
+                return std::nullopt;
+            }
+
+            // Start playing the MIDI file, as many times as asked for
+            if (m_Settings.loopCount > 1)
+                fluid_player_set_loop(player, m_Settings.loopCount);
+            fluid_player_play(player);
+
+            // Format and buffer sizes. FluidSynth renders stereo, which is written as it is or mixed down
+            const int  numChannels   = m_Settings.channels;
+            const int  bitsPerSample = m_Settings.bitsPerSample;
+            const bool renderFloat   = m_Settings.floatRender || numChannels != 2 || bitsPerSample != 16;
+            const int  blockFrames   = 1024;      // Frames rendered between two playback status checks
+            const int  reserveFrames = 64 * 1024; // Frames to make room for up front
+            const int  fadeFrames    = sampleRate / 100;
+            const int  silencePeak   = 16;        // Dither and decayed reverb stay below this
+
+            auto framesOf = [sampleRate](std::chrono::milliseconds duration) {
+                return static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)) * sampleRate / 1000;
+            };
+            const uint64_t maxFrames     = m_Settings.maxRenderDuration.count() > 0 ?
+                                               framesOf(m_Settings.maxRenderDuration) :
+                                               UINT64_MAX;
+            const uint64_t silenceFrames = framesOf(m_Settings.silenceCutoff);
+            const auto     deadline      = std::chrono::steady_clock::now() + m_Settings.renderTimeBudget;
+
+            WavRender render;
+            WavWriter wavWriter(render.data, sampleRate, numChannels, bitsPerSample, reserveFrames);
+            uint64_t  silentFrames = 0;
+            bool      heardSound   = false;
+
+            // The float path renders each side into a block of its own and converts from there
+            std::vector<float> left(renderFloat ? blockFrames : 0);
+            std::vector<float> right(renderFloat ? blockFrames : 0);
+            const float*       ditherTable = m_Settings.dither ? getDitherTable() : nullptr;
+            size_t             ditherPos   = 0;
+
+            // Render a block into the WAV, returns its peak level when silence is watched for
+            auto renderBlock = [&](int frameCount) {
+                size_t sampleCount = static_cast<size_t>(frameCount) * numChannels;
+                if (!renderFloat)
+                {
+                    int16_t* frames = wavWriter.nextFrames<int16_t>(frameCount);
+                    fluid_synth_write_s16(synth, frameCount, frames, 0, numChannels, frames, 1, numChannels);
+                    return silenceFrames > 0 ? peakLevel(frames, sampleCount) : 0;
+                }
 
-                // Continue searching for 'MThd' until no more headers are found in the buffer
-                while (searchPos < buffer.size())
+                fluid_synth_write_float(synth, frameCount, left.data(), 0, 1, right.data(), 0, 1);
+                if (bitsPerSample == 32)
                 {
-                    // Find MIDI header 'MThd'
-                    size_t headerPos = findSequenceInBuffer(buffer, MAGIC_MIDI_HEADER, searchPos);
-                    if (headerPos != std::string::npos)
+                    float* frames = wavWriter.nextFrames<float>(frameCount);
+                    interleaveFloat(left.data(), right.data(), frameCount, numChannels, frames);
+                    return silenceFrames > 0 ? peakLevel(frames, sampleCount) : 0;
+                }
+
+                int16_t*     frames = wavWriter.nextFrames<int16_t>(frameCount);
+                const float* dither = ditherTable ? ditherTable + ditherPos : nullptr;
+                ditherPos           = (ditherPos + sampleCount) % DITHER_SIZE;
+                getSampleConverter()(left.data(), right.data(), frameCount, numChannels, dither, frames);
+                return silenceFrames > 0 ? peakLevel(frames, sampleCount) : 0;
+            };
+
+            // Loop until MIDI playback finishes or a limit is hit, rendering interleaved frames straight into the WAV
+            {
+                stats::ScopedTimer timer(stats::Counter::RenderNanos);
+                while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+                {
+                    if (wavWriter.getFrameCount() >= maxFrames)
+                    {
+                        render.limit = RenderLimit::Duration;
+                        break;
+                    }
+                    if (m_Settings.renderTimeBudget.count() > 0 && std::chrono::steady_clock::now() >= deadline)
                     {
-                        // From the found header to the end of the buffer, assume it's a MIDI file
-                        std::vector<char> currentMidi;
-                        currentMidi.insert(currentMidi.end(), buffer.begin() + headerPos, buffer.end());
+                        render.limit = RenderLimit::Time;
+                        break;
+                    }
 
-                        // Add the found MIDI file to the result list
-                        midiFiles.emplace_back(currentMidi);
+                    // The last block before the duration limit is shortened to end right on it
+                    uint64_t framesLeft = maxFrames - wavWriter.getFrameCount();
+                    int      frameCount = static_cast<int>(std::min<uint64_t>(blockFrames, framesLeft));
+                    int      peak       = renderBlock(frameCount);
 
-                        // Move the search position forward to avoid infinite loop
-                        searchPos = headerPos + MAGIC_MIDI_HEADER.size();
+                    if (silenceFrames == 0)
+                        continue;
+                    if (peak > silencePeak)
+                    {
+                        heardSound   = true;
+                        silentFrames = 0;
                     }
-                    else
+                    else if (heardSound && (silentFrames += frameCount) >= silenceFrames)
                     {
-                        // No more MIDI headers found in this buffer, stop searching
+                        render.limit = RenderLimit::Silence;
                         break;
                     }
                 }
+
+                // A tail of silence ends quietly already
+                if (render.limit == RenderLimit::Duration || render.limit == RenderLimit::Time)
+                {
+                    if (bitsPerSample == 32)
+                        wavWriter.fadeOut<float>(fadeFrames);
+                    else
+                        wavWriter.fadeOut<int16_t>(fadeFrames);
+                }
+                wavWriter.finish();
             }
+            render.frames = wavWriter.getFrameCount();
 
-            return midiFiles;
+            stats::add(stats::Counter::WavsRendered, 1);
+            stats::add(stats::Counter::AudioNanos, render.frames * 1000000000 / sampleRate);
+            if (render.limit == RenderLimit::Duration)
+                stats::add(stats::Counter::WavsCutByDuration, 1);
+            else if (render.limit == RenderLimit::Time)
+                stats::add(stats::Counter::WavsCutByTime, 1);
+            else if (render.limit == RenderLimit::Silence)
+                stats::add(stats::Counter::WavsCutBySilence, 1);
+
+            // Clean up resources
+            delete_fluid_player(player);
+            return render;
         }
 
-        void MidiHunter::saveFiles(const std::vector<MidiFile>& midiFiles,
-                                   const std::string&           outputDir,
-                                   const std::string&           prefix) const
+        void MidiHunter::exportWAVFile(const MidiFile& midiFile, const std::filesystem::path& outputFileName) const
         {
-            // Check if the output directory exists, if not, create it
-            std::filesystem::path dir(outputDir);
-            if (!std::filesystem::exists(dir))
+            auto render = renderWAV(midiFile);
+            if (!render)
+                return;
+
+            CarvedData data;
+            size_t     wavSize = render->data.size();
+            data.append(makeSharedBuffer(std::move(render->data)), 0, wavSize);
+            getSink().write(outputFileName, std::move(data));
+
+            // Written at once so renders running in parallel do not interleave their output
+            if (!m_Settings.quiet)
             {
-                if (!std::filesystem::create_directories(dir))
-                {
-                    std::cerr << "Error: Failed to create output directory: " << outputDir << std::endl;
-                    throw std::runtime_error("Failed to create output directory.");
-                }
+                std::string limit = render->limit == RenderLimit::None ?
+                                        std::string() :
+                                        std::string(" (cut at the ") + getRenderLimitName(render->limit) + " limit)";
+                std::cout << ("MIDI to WAV conversion complete. Output saved as '" +
+                              outputFileName.generic_string() + "'" + limit + ".\n");
             }
+        }
 
-            // Iterate over all MIDI files and save them
-            for (size_t i = 0; i < midiFiles.size(); ++i)
-            {
-                // Construct the output file path with the prefix and index
-                std::string           fileName = prefix + std::to_string(i) + ".mid";
-                std::filesystem::path filePath = dir / fileName;
+        bool huntAssets(const io::ZipArchive& archive, const AssetCallback& onAsset, const HuntSettings& settings)
+        {
+            HunterSet<PngHunter, MidiHunter> hunters;
+            PngHunterSettings                pngSettings;
+            pngSettings.verifyCRC = settings.verifyPngCRC;
+            hunters.get<PngHunter>().setSettings(pngSettings);
+
+            // Where every buffer came from, by its data. A buffer is only freed once no asset carried over holds it,
+            // so an address is always registered again before its memory is reused
+            std::unordered_map<const char*, AssetSource> sources;
+            bool                                         stopped = false;
 
-                // Open a binary file stream for writing
-                std::ofstream outputFile(filePath, std::ios::binary);
-                if (!outputFile)
+            auto onFiles = [&](size_t hunterIndex, const auto&, auto&& files) {
+                for (auto& file : files)
                 {
-                    std::cerr << "Error: Failed to open file for writing: " << filePath << std::endl;
-                    throw std::runtime_error("Failed to open file for writing.");
+                    if (stopped || settings.stopToken.stop_requested())
+                    {
+                        stopped = true;
+                        return;
+                    }
+
+                    const ByteView& first  = file.data.getSegments().front();
+                    AssetSource     source = sources.at(first.buffer->data());
+                    source.offset          = first.offset;
+
+                    AssetType type = hunterIndex == 0 ? AssetType::PNG : AssetType::MIDI;
+                    if (!onAsset({type, std::move(file.data), file.contentHash, std::move(source)}))
+                        stopped = true;
                 }
+            };
 
-                // Write the MIDI data to the file
-                outputFile.write(midiFiles[i].data.data(), midiFiles[i].data.size());
-                if (!outputFile)
+            auto onEntry = [&](size_t index, SharedBuffer buffer) {
+                if (stopped || settings.stopToken.stop_requested())
                 {
-                    std::cerr << "Error: Failed to write MIDI data to file: " << filePath << std::endl;
-                    throw std::runtime_error("Failed to write MIDI data to file.");
+                    stopped = true;
+                    return false;
                 }
 
-                // Close the file
-                outputFile.close();
-                std::cout << "MIDI file saved: " << filePath << std::endl;
+                AssetSource source {index, archive.getEntryName(index), 0, false};
+                if (!buffer->empty())
+                    sources.insert_or_assign(buffer->data(), source);
+                hunters.parseStreamBuffer(buffer, onFiles);
 
-                // If export WAV
-                if (m_Settings.exportWAV)
+                if (settings.stream.embedded && !stopped)
                 {
-                    std::string           outWAVFile     = prefix + std::to_string(i) + ".wav";
-                    std::filesystem::path outWAVFilePath = dir / outWAVFile;
-                    exportWAVFile(filePath.generic_string(), outWAVFilePath.generic_string());
+                    source.embedded = true;
+                    for (auto& stream : io::inflateEmbeddedStreams(*buffer, *settings.stream.embedded))
+                    {
+                        auto embedded = makeSharedBuffer(std::move(stream));
+                        if (!embedded->empty())
+                            sources.insert_or_assign(embedded->data(), source);
+                        hunters.parseEmbeddedBuffer(embedded, onFiles);
+                        if (stopped)
+                            break;
+                        ++source.streamIndex;
+                    }
                 }
-            }
+                return !stopped;
+            };
+
+            // Entries inflated ahead are held to the same cap as the assets waiting to be taken
+            archive.streamEntries(settings.stream.inflateThreads, onEntry, settings.stream.memoryLimit);
+            if (!stopped && !settings.stopToken.stop_requested())
+                hunters.finishStream(onFiles);
+            return !stopped;
+        }
+
+        AssetStream::AssetStream(const std::string& jarPath, HuntSettings settings) :
+            m_Assets(settings.stream.memoryLimit)
+        {
+            m_Hunter = std::thread([this, jarPath, settings = std::move(settings)]() mutable {
+                try
+                {
+                    // The caller's stop token cancels like cancel() does, the hunt only watches ours
+                    std::stop_callback forwardStop(settings.stopToken, [this] { m_Stop.request_stop(); });
+                    settings.stopToken = m_Stop.get_token();
+
+                    io::ZipArchive archive(jarPath);
+                    huntAssets(
+                        archive,
+                        [this](FoundAsset&& asset) {
+                            size_t size = asset.data.size();
+                            return m_Assets.push(std::move(asset), size);
+                        },
+                        settings);
+                }
+                catch (...)
+                {
+                    m_Error = std::current_exception();
+                }
+                m_Assets.close();
+            });
         }
 
-        void MidiHunter::setSettings(const MidiHunterSettings& settings) { m_Settings = settings; }
+        AssetStream::~AssetStream()
+        {
+            cancel();
+            m_Hunter.join();
+        }
 
-        void MidiHunter::exportWAVFile(const std::string& midiFileName, const std::string& outputFileName) const
+        std::optional<FoundAsset> AssetStream::next()
         {
-            // Initialize FluidSynth settings
-            fluid_settings_t* settings = new_fluid_settings();
+            auto asset = m_Assets.pop();
 
-            // Set the sample rate and other settings for WAV output
-            int sampleRate = 44100; // Standard sample rate
-            fluid_settings_setnum(settings, "synth.sample-rate", sampleRate);
+            // Once the queue is drained the hunter is done with m_Error, unless it was cancelled and is still running
+            if (!asset && !m_Stop.stop_requested() && m_Error)
+                std::rethrow_exception(m_Error);
+            return asset;
+        }
 
-            // Create FluidSynth synthesizer
-            fluid_synth_t* synth = new_fluid_synth(settings);
+        void AssetStream::cancel()
+        {
+            m_Stop.request_stop();
+            m_Assets.cancel();
+        }
 
-            // Load a SoundFont
-            if (fluid_synth_sfload(synth, m_Settings.soundFontPath.c_str(), 1) == FLUID_FAILED)
+        std::string Manifest::toJson() const
+        {
+            std::ostringstream json;
+            json << "{\n";
+            json << "  \"jar\": " << cli::quoteJson(jarPath) << ",\n";
+            json << "  \"fingerprint\": \"" << toHex(fingerprint) << "\",\n";
+            json << "  \"assets\": [";
+            for (size_t i = 0; i < records.size(); ++i)
             {
-                std::cerr << "Error: Failed to load SoundFont." << std::endl;
-                delete_fluid_synth(synth);
-                delete_fluid_settings(settings);
-                return;
+                // One asset per line, so manifests diff and grep well
+                const auto& record = records[i];
+                json << (i == 0 ? "\n" : ",\n") << "    {\"type\": \""
+                     << (record.type == AssetType::PNG ? "png" : "midi") << "\", \"entry\": "
+                     << cli::quoteJson(record.source.entryName) << ", \"entryIndex\": " << record.source.entryIndex;
+                if (record.source.embedded)
+                    json << ", \"stream\": " << record.source.streamIndex;
+                json << ", \"offset\": " << record.source.offset << ", \"size\": " << record.size
+                     << ", \"hash\": \"" << toHex(record.contentHash) << "\"";
+                if (record.type == AssetType::PNG)
+                    json << ", \"width\": " << record.width << ", \"height\": " << record.height;
+                else
+                    json << ", \"tracks\": " << record.trackCount;
+                json << "}";
             }
+            json << (records.empty() ? "]\n" : "\n  ]\n");
+            json << "}\n";
+            return json.str();
+        }
 
-            // Create a FluidSynth player to load and play the MIDI file
-            fluid_player_t* player = new_fluid_player(synth);
-            if (fluid_player_add(player, midiFileName.c_str()) == FLUID_FAILED)
+        void Manifest::save(const std::string& path) const
+        {
+            std::ofstream file(path, std::ios::binary);
+            if (!file)
             {
-                std::cerr << "Error: Failed to load MIDI file." << std::endl;
-                delete_fluid_player(player);
-                delete_fluid_synth(synth);
-                delete_fluid_settings(settings);
-                return;
+                std::cerr << "Error: Failed to open file for writing: " << path << std::endl;
+                throw std::runtime_error("Failed to open file for writing.");
             }
 
-            // Start playing the MIDI file
-            fluid_player_play(player);
+            file.write(MANIFEST_MAGIC.data(), static_cast<std::streamsize>(MANIFEST_MAGIC.size()));
+            writeCacheString(file, jarPath);
+            writeIntLE(file, fingerprint, 8);
 
-            // Prepare output WAV file
-            std::ofstream wavFile(outputFileName, std::ios::binary);
-            if (!wavFile)
+            // Entry names are stored once, records only refer to their entry by index
+            std::map<size_t, std::string> entryNames;
+            for (const auto& record : records)
+                entryNames.try_emplace(record.source.entryIndex, record.source.entryName);
+            writeIntLE(file, entryNames.size(), 4);
+            for (const auto& [index, name] : entryNames)
             {
-                std::cerr << "Error: Unable to open output WAV file." << std::endl;
-                return;
+                writeIntLE(file, index, 4);
+                writeCacheString(file, name);
             }
 
-            // Number of channels, bits per sample, and buffer size
-            const int numChannels   = 2;    // Stereo
-            const int bitsPerSample = 16;   // 16-bit audio
-            const int bufferSize    = 1024; // Size of the buffer to process
+            writeIntLE(file, records.size(), 4);
+            for (const auto& record : records)
+            {
+                writeIntLE(file, static_cast<uint8_t>(record.type), 1);
+                writeIntLE(file, record.source.entryIndex, 4);
+                writeIntLE(file, record.source.offset, 8);
+                writeIntLE(file, record.source.embedded ? 1 : 0, 1);
+                writeIntLE(file, record.source.streamIndex, 4);
+                writeIntLE(file, record.size, 8);
+                writeIntLE(file, record.contentHash, 8);
+                writeIntLE(file, record.width, 4);
+                writeIntLE(file, record.height, 4);
+                writeIntLE(file, record.trackCount, 2);
+            }
 
-            // Prepare to store audio data
-            int16_t* leftBuffer   = new int16_t[bufferSize]; // Left channel
-            int16_t* rightBuffer  = new int16_t[bufferSize]; // Right channel
-            int      totalSamples = 0;                       // Count the total number of samples written
+            file.close();
+            if (!file)
+            {
+                std::cerr << "Error: Failed to write manifest file: " << path << std::endl;
+                throw std::runtime_error("Failed to write manifest file.");
+            }
+        }
 
-            // Write a placeholder WAV header (we'll overwrite this later with correct data size)
-            writeWavHeader(wavFile, sampleRate, numChannels, bitsPerSample, 0);
+        Manifest Manifest::load(const std::string& path)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+            {
+                std::cerr << "Error: Failed to open manifest file: " << path << std::endl;
+                throw std::runtime_error("Failed to open manifest file.");
+            }
 
-            // Loop until MIDI playback finishes
-            while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+            try
             {
-                // Synthesize audio data and write it to the buffers
-                fluid_synth_write_s16(synth, bufferSize, leftBuffer, 0, 1, rightBuffer, 0, 1);
+                std::string magic(MANIFEST_MAGIC.size(), '\0');
+                file.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+                if (!file || magic != MANIFEST_MAGIC)
+                    throw std::runtime_error("Not a manifest file.");
+
+                Manifest manifest;
+                manifest.jarPath     = readCacheString(file);
+                manifest.fingerprint = readIntLE(file, 8);
+
+                std::unordered_map<size_t, std::string> entryNames;
+                uint64_t                                entryCount = readIntLE(file, 4);
+                for (uint64_t i = 0; i < entryCount; ++i)
+                {
+                    size_t index      = readIntLE(file, 4);
+                    entryNames[index] = readCacheString(file);
+                }
 
-                // Write audio data to the WAV file
-                for (int i = 0; i < bufferSize; ++i)
+                uint64_t recordCount = readIntLE(file, 4);
+                for (uint64_t i = 0; i < recordCount; ++i)
                 {
-                    wavFile.write(reinterpret_cast<const char*>(&leftBuffer[i]), sizeof(int16_t));
-                    wavFile.write(reinterpret_cast<const char*>(&rightBuffer[i]), sizeof(int16_t));
+                    ManifestRecord record;
+                    record.type               = static_cast<AssetType>(readIntLE(file, 1));
+                    record.source.entryIndex  = readIntLE(file, 4);
+                    record.source.offset      = readIntLE(file, 8);
+                    record.source.embedded    = readIntLE(file, 1) != 0;
+                    record.source.streamIndex = readIntLE(file, 4);
+                    record.size               = readIntLE(file, 8);
+                    record.contentHash        = readIntLE(file, 8);
+                    record.width              = static_cast<uint32_t>(readIntLE(file, 4));
+                    record.height             = static_cast<uint32_t>(readIntLE(file, 4));
+                    record.trackCount         = static_cast<uint16_t>(readIntLE(file, 2));
+
+                    auto name = entryNames.find(record.source.entryIndex);
+                    if (name == entryNames.end())
+                        throw std::runtime_error("Corrupt file.");
+                    record.source.entryName = name->second;
+                    manifest.records.push_back(std::move(record));
                 }
+                return manifest;
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cerr << "Error: Failed to read manifest file " << path << ": " << error.what() << std::endl;
+                throw std::runtime_error("Failed to read manifest file.");
+            }
+        }
+
+        ManifestRecord describeAsset(const FoundAsset& asset)
+        {
+            ManifestRecord record {asset.type, asset.source, asset.data.size(), asset.contentHash};
+
+            // Carved assets passed the signature and header checks, so the fields are where the formats put them
+            auto head = readAssetHead(asset.data);
+            if (asset.type == AssetType::PNG)
+            {
+                // Signature, IHDR length and type, then width and height
+                record.width = (uint32_t(head[16]) << 24) | (uint32_t(head[17]) << 16) | (uint32_t(head[18]) << 8) |
+                               head[19];
+                record.height = (uint32_t(head[20]) << 24) | (uint32_t(head[21]) << 16) | (uint32_t(head[22]) << 8) |
+                                head[23];
+            }
+            else
+            {
+                // MThd, header length and format, then the number of tracks
+                record.trackCount = static_cast<uint16_t>((head[10] << 8) | head[11]);
+            }
+            return record;
+        }
+
+        Manifest buildManifest(const io::ZipArchive& archive, const HuntSettings& settings)
+        {
+            Manifest manifest;
+            manifest.jarPath     = archive.getPath();
+            manifest.fingerprint = archive.getFingerprint();
+            huntAssets(
+                archive,
+                [&manifest](FoundAsset&& asset) {
+                    manifest.records.push_back(describeAsset(asset));
+                    return true;
+                },
+                settings);
+            return manifest;
+        }
 
-                totalSamples += bufferSize;
+        CarvedData loadAsset(const io::ZipArchive& archive, const ManifestRecord& record, const HuntSettings& settings)
+        {
+            size_t index = record.source.entryIndex;
+            if (index >= archive.getNumEntries())
+            {
+                std::cerr << "Error: No entry " << index << " in " << archive.getPath() << std::endl;
+                throw std::runtime_error("Asset entry not found.");
             }
 
-            // Calculate the final size of the audio data
-            int dataSize = totalSamples * numChannels * bitsPerSample / 8;
+            SharedBuffer buffer = archive.readEntries(index, 1).front();
+            if (record.source.embedded)
+            {
+                if (!settings.stream.embedded)
+                {
+                    std::cerr << "Error: Embedded stream settings are needed to load an embedded asset." << std::endl;
+                    throw std::runtime_error("Embedded stream settings are needed to load an embedded asset.");
+                }
 
-            // Seek back to the beginning of the file and write the correct header
-            wavFile.seekp(0, std::ios::beg);
-            writeWavHeader(wavFile, sampleRate, numChannels, bitsPerSample, dataSize);
+                auto streams = io::inflateEmbeddedStreams(*buffer, *settings.stream.embedded);
+                if (record.source.streamIndex >= streams.size())
+                {
+                    std::cerr << "Error: No embedded stream " << record.source.streamIndex << " in "
+                              << record.source.entryName << std::endl;
+                    throw std::runtime_error("Asset stream not found.");
+                }
+                buffer = makeSharedBuffer(std::move(streams[record.source.streamIndex]));
+            }
 
-            // Clean up resources
-            delete[] leftBuffer;
-            delete[] rightBuffer;
-            wavFile.close();
-            delete_fluid_player(player);
-            delete_fluid_synth(synth);
-            delete_fluid_settings(settings);
+            // An asset in the entries themselves may go on in the entries after the first, like it was carved.
+            // One in an embedded stream never does
+            CarvedData data;
+            size_t     offset = record.source.offset;
+            while (true)
+            {
+                if (offset < buffer->size())
+                    data.append(buffer, offset, std::min<uint64_t>(buffer->size() - offset, record.size - data.size()));
+                if (data.size() == record.size || record.source.embedded || ++index >= archive.getNumEntries())
+                    break;
+                buffer = archive.readEntries(index, 1).front();
+                offset = 0;
+            }
 
-            std::cout << "MIDI to WAV conversion complete. Output saved as '" << outputFileName << "'." << std::endl;
+            if (data.size() != record.size || data.contentHash() != record.contentHash)
+            {
+                std::cerr << "Error: The asset at " << record.source.entryName << "+" << record.source.offset
+                          << " does not match its manifest record." << std::endl;
+                throw std::runtime_error("Asset does not match its manifest record.");
+            }
+            return data;
         }
     } // namespace hunter
 } // namespace jhunter
\ No newline at end of file
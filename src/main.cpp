@@ -1,6 +1,585 @@
 #include "j2me-asset-hunter/lib.hpp"
 
+#include <atomic>
+#include <csignal>
 #include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+    using Hunters = jhunter::hunter::HunterSet<jhunter::hunter::PngHunter, jhunter::hunter::MidiHunter>;
+    using Clock   = std::chrono::steady_clock;
+
+    struct HuntSettings
+    {
+        jhunter::hunter::PngHunterSettings  png {};
+        jhunter::hunter::MidiHunterSettings midi {};
+
+        std::shared_ptr<jhunter::hunter::ResultCache> cache;
+
+        // Also hunt in the zlib and gzip streams found inside entries when set
+        std::optional<jhunter::io::EmbeddedStreamSettings> embedded;
+
+        // How every jar is opened: memory-mapped and with an entry filter or not
+        jhunter::io::ArchiveSettings archive {};
+    };
+
+    // The streams embedded in every buffer, inflated on the pool. Slot i belongs to buffers[i]
+    std::vector<std::vector<jhunter::io::Buffer>> inflateEmbedded(const std::vector<jhunter::io::SharedBytes>& buffers,
+                                                                  const jhunter::io::EmbeddedStreamSettings&   settings,
+                                                                  std::pmr::memory_resource*                   resource,
+                                                                  size_t                                       jobs)
+    {
+        std::vector<std::vector<jhunter::io::Buffer>> embedded(buffers.size());
+        jhunter::pipeline::TaskPool                   pool(jobs);
+        for (size_t i = 0; i < buffers.size(); ++i)
+            pool.submit([&, i] { embedded[i] = jhunter::io::inflateEmbeddedStreams(*buffers[i], settings, resource); });
+        pool.wait();
+        return embedded;
+    }
+
+    void configureHunters(Hunters& hunters, const HuntSettings& settings)
+    {
+        hunters.get<jhunter::hunter::PngHunter>().setSettings(settings.png);
+        hunters.get<jhunter::hunter::MidiHunter>().setSettings(settings.midi);
+    }
+
+    // Cache records use absolute paths, so runs from another working directory still find them
+    std::string cacheKeyPath(const std::filesystem::path& path)
+    {
+        return std::filesystem::weakly_canonical(std::filesystem::absolute(path)).generic_string();
+    }
+
+    // Record of a hunted jar for the result cache, with the assets that ended up on disk
+    jhunter::hunter::ResultCache::JarRecord makeJarRecord(const HuntSettings&                           settings,
+                                                          const std::filesystem::path&                  jarPath,
+                                                          uint64_t                                      fingerprint,
+                                                          const std::string&                            outPath,
+                                                          const std::vector<jhunter::hunter::PngFile>&  pngFiles,
+                                                          const std::vector<jhunter::hunter::MidiFile>& midiFiles)
+    {
+        using jhunter::hunter::ResultCache;
+
+        ResultCache::JarRecord record;
+        record.jarPath     = cacheKeyPath(jarPath);
+        record.fingerprint = fingerprint;
+        record.outPath     = cacheKeyPath(outPath);
+
+        // Writes may still be queued in the sink, so what was saved is told by the dedup table, not the disk
+        auto isDuplicate = [&settings](const std::filesystem::path& path) {
+            return settings.png.dedup && settings.png.dedup->isDuplicate(path);
+        };
+
+        auto addAsset = [&](ResultCache::AssetType type, const auto& file, const std::string& fileName) {
+            std::filesystem::path path = std::filesystem::path(outPath) / fileName;
+            if (isDuplicate(path))
+                return;
+
+            std::filesystem::path wavPath = path;
+            wavPath.replace_extension(".wav");
+            bool hasWAV = type == ResultCache::AssetType::MIDI && settings.midi.exportWAV && !isDuplicate(wavPath);
+            record.assets.push_back({type, file.contentHash, file.data.size(), fileName, hasWAV});
+        };
+
+        for (size_t i = 0; i < pngFiles.size(); ++i)
+            addAsset(ResultCache::AssetType::PNG, pngFiles[i], "image_" + std::to_string(i) + ".png");
+        for (size_t i = 0; i < midiFiles.size(); ++i)
+            addAsset(ResultCache::AssetType::MIDI, midiFiles[i], "audio_" + std::to_string(i) + ".mid");
+        return record;
+    }
+
+    // Look a jar up in the cache. On a hit its assets are announced to the dedup table, as if saved again
+    bool restoreJar(const HuntSettings&          settings,
+                    const std::filesystem::path& jarPath,
+                    uint64_t                     fingerprint,
+                    const std::string&           outPath)
+    {
+        if (!settings.cache)
+            return false;
+
+        auto record = settings.cache->findJar(cacheKeyPath(jarPath), fingerprint, cacheKeyPath(outPath));
+        if (!record)
+            return false;
+
+        if (settings.png.dedup)
+        {
+            for (const auto& asset : record->assets)
+                settings.png.dedup->addOriginal(asset.hash, asset.size, std::filesystem::path(outPath) / asset.fileName);
+        }
+
+        if (!settings.png.quiet)
+            std::cout << "Skipping unchanged jar: " + jarPath.generic_string() + "\n" << std::flush;
+        return true;
+    }
+
+    // A jar of a batch, shared by the tasks working on it
+    struct BatchJar
+    {
+        // Called once the last task let go of the jar, so every file of it is saved
+        ~BatchJar()
+        {
+            if (!onFinished)
+                return;
+            try
+            {
+                onFinished(*this);
+            }
+            catch (const std::exception& error)
+            {
+                std::cerr << "Error: Failed to report " << jarPath << ": " << error.what() << std::endl;
+            }
+        }
+
+        std::filesystem::path jarPath;
+        std::string           outPath;
+
+        std::unique_ptr<jhunter::io::ZipArchive>      archive;
+        uint64_t                                      fingerprint = 0;
+        std::shared_ptr<jhunter::memory::Arena>       arena; // Holds buffers and embedded streams
+        std::vector<jhunter::io::SharedBytes>         buffers;
+        std::vector<std::vector<jhunter::io::Buffer>> embedded;
+        std::atomic<size_t>                           pendingReads {0};
+        std::atomic<size_t>                           pendingSaves {0};
+
+        Hunters                               hunters;
+        std::vector<jhunter::hunter::PngFile>  pngFiles;
+        std::vector<jhunter::hunter::MidiFile> midiFiles;
+
+        const HuntSettings*                 settings = nullptr;
+        std::shared_ptr<const HuntSettings> ownedSettings; // Settings of a single server job
+
+        std::atomic<bool>    failed {false};
+        std::atomic<size_t>* failedJars = nullptr;
+        std::string          error; // The first failure, written by the task that set failed
+
+        // For the completion records of the server
+        bool                                  restored = false; // Skipped as unchanged since cached
+        Clock::time_point                     received = Clock::now();
+        Clock::time_point                     started  = received;
+        std::function<void(const BatchJar&)> onFinished;
+
+        void fail(const std::exception& cause)
+        {
+            std::cerr << "Error: Failed to hunt " << jarPath << ": " << cause.what() << std::endl;
+            if (!failed.exchange(true))
+            {
+                error = cause.what();
+                ++*failedJars;
+            }
+        }
+    };
+
+    // Entries per read task, small jars are not worth a libzip handle per entry
+    constexpr size_t MIN_ENTRIES_PER_TASK = 16;
+
+    // Runs after the last save of a jar, the jar is cached once all its assets made it to disk
+    void finishSave(const std::shared_ptr<BatchJar>& jar)
+    {
+        if (--jar->pendingSaves != 0 || jar->failed || !jar->settings->cache)
+            return;
+
+        try
+        {
+            jar->settings->cache->storeJar(makeJarRecord(
+                *jar->settings, jar->jarPath, jar->fingerprint, jar->outPath, jar->pngFiles, jar->midiFiles));
+        }
+        catch (const std::exception& error)
+        {
+            jar->fail(error);
+        }
+    }
+
+    // Runs once all entries of a jar are inflated: scan and carve in entry order, then queue the writes.
+    // Every MIDI is its own task, so WAV renders of all jars spread over the whole pool
+    void carveJar(jhunter::pipeline::TaskPool& pool, const std::shared_ptr<BatchJar>& jar)
+    {
+        if (jar->failed)
+            return;
+
+        try
+        {
+            // From here on the buffers keep the arena alive, it goes away with the last asset written
+            for (size_t i = 0; i < jar->buffers.size(); ++i)
+            {
+                jar->hunters.addSourceBuffer(std::move(jar->buffers[i]));
+                if (i < jar->embedded.size())
+                {
+                    for (auto& stream : jar->embedded[i])
+                    {
+                        jar->hunters.addEmbeddedBuffer(
+                            jhunter::hunter::makeSharedBuffer(std::move(stream), jar->arena));
+                    }
+                }
+            }
+            jar->buffers  = {};
+            jar->embedded = {};
+            jar->arena.reset();
+
+            jar->pngFiles  = jar->hunters.get<jhunter::hunter::PngHunter>().parseFiles();
+            jar->midiFiles = jar->hunters.get<jhunter::hunter::MidiHunter>().parseFiles();
+        }
+        catch (const std::exception& error)
+        {
+            jar->fail(error);
+            return;
+        }
+
+        jar->pendingSaves = 1 + jar->midiFiles.size();
+        pool.submit([jar] {
+            try
+            {
+                jar->hunters.get<jhunter::hunter::PngHunter>().saveFiles(jar->pngFiles, jar->outPath, "image_");
+            }
+            catch (const std::exception& error)
+            {
+                jar->fail(error);
+            }
+            finishSave(jar);
+        });
+
+        for (size_t i = 0; i < jar->midiFiles.size(); ++i)
+        {
+            pool.submit([jar, i] {
+                try
+                {
+                    jar->hunters.get<jhunter::hunter::MidiHunter>().saveFile(
+                        jar->midiFiles[i], jar->outPath, "audio_", i);
+                }
+                catch (const std::exception& error)
+                {
+                    jar->fail(error);
+                }
+                finishSave(jar);
+            });
+        }
+    }
+
+    // Open a jar and split its entries into read tasks, the last one to finish carries on with carveJar
+    void startJar(jhunter::pipeline::TaskPool& pool, const std::shared_ptr<BatchJar>& jar)
+    {
+        const HuntSettings& settings = *jar->settings;
+        size_t numEntries = 0;
+        jar->started      = Clock::now();
+        try
+        {
+            jar->archive = std::make_unique<jhunter::io::ZipArchive>(jar->jarPath.generic_string(), settings.archive);
+            numEntries   = jar->archive->getNumEntries();
+
+            // Only the central directory is read to tell whether the jar changed since it was cached
+            if (settings.cache)
+            {
+                jar->fingerprint = jar->archive->getFingerprint();
+                jar->restored = restoreJar(settings, jar->jarPath, jar->fingerprint, jar->outPath);
+                if (jar->restored)
+                    return;
+            }
+        }
+        catch (const std::exception& error)
+        {
+            jar->fail(error);
+            return;
+        }
+
+        size_t entriesPerTask = std::max(MIN_ENTRIES_PER_TASK, (numEntries + pool.size() - 1) / pool.size());
+        size_t taskCount      = (numEntries + entriesPerTask - 1) / entriesPerTask;
+        if (taskCount == 0)
+        {
+            carveJar(pool, jar);
+            return;
+        }
+
+        jar->arena = std::make_shared<jhunter::memory::Arena>();
+        jar->buffers.resize(numEntries);
+        if (settings.embedded)
+            jar->embedded.resize(numEntries);
+        jar->pendingReads = taskCount;
+        for (size_t first = 0; first < numEntries; first += entriesPerTask)
+        {
+            pool.submit([&pool, jar, first, entriesPerTask] {
+                try
+                {
+                    auto buffers = jar->archive->readEntries(first, entriesPerTask, jar->arena);
+                    for (size_t i = 0; i < buffers.size() && jar->settings->embedded; ++i)
+                    {
+                        jar->embedded[first + i] = jhunter::io::inflateEmbeddedStreams(
+                            *buffers[i], *jar->settings->embedded, jar->arena.get());
+                    }
+                    std::move(buffers.begin(), buffers.end(), jar->buffers.begin() + first);
+                }
+                catch (const std::exception& error)
+                {
+                    jar->fail(error);
+                }
+
+                if (--jar->pendingReads == 0)
+                    carveJar(pool, jar);
+            });
+        }
+    }
+
+    // One SoundFont load for all jars, with a synth for every worker that may render
+    void shareSynths(HuntSettings& settings, size_t jobs)
+    {
+        settings.midi.renderThreads = 1;
+        try
+        {
+            settings.midi.synthPool =
+                std::make_shared<jhunter::hunter::SynthPool>(settings.midi.soundFontPath, jobs, settings.midi.synth);
+        }
+        catch (const std::runtime_error&)
+        {
+            // Already reported, the MIDI files are still saved without their WAVs
+            settings.midi.exportWAV = false;
+        }
+    }
+
+    // The folder of every jar of a batch, under outRoot (or next to the working directory when outRoot is empty)
+    std::vector<std::string> makeBatchOutPaths(const std::vector<std::filesystem::path>& jarPaths,
+                                               const std::string&                        outRoot)
+    {
+        std::vector<std::string>        outPaths;
+        std::unordered_set<std::string> usedOutPaths;
+        for (const auto& jarPath : jarPaths)
+        {
+            // Jars with the same name in different directories get numbered folders
+            std::string stem    = jarPath.stem().generic_string();
+            std::string outPath = outRoot.empty() ? stem + "_out" : (std::filesystem::path(outRoot) / stem).string();
+            for (size_t n = 2; !usedOutPaths.insert(outPath).second; ++n)
+            {
+                std::string numbered = stem + "_" + std::to_string(n);
+                outPath = outRoot.empty() ? numbered + "_out" : (std::filesystem::path(outRoot) / numbered).string();
+            }
+            outPaths.push_back(std::move(outPath));
+        }
+        return outPaths;
+    }
+
+    // Hunt every jar on one shared pool, each into its own folder under outRoot (or next to the working
+    // directory when outRoot is empty). Returns the number of jars that failed
+    size_t huntBatch(const std::vector<std::filesystem::path>& jarPaths,
+                     const std::string&                        outRoot,
+                     HuntSettings                              settings,
+                     size_t                                    jobs)
+    {
+        shareSynths(settings, jobs);
+
+        jhunter::pipeline::TaskPool pool(jobs);
+        std::atomic<size_t>         failedJars {0};
+        auto                        outPaths = makeBatchOutPaths(jarPaths, outRoot);
+
+        for (size_t i = 0; i < jarPaths.size(); ++i)
+        {
+            auto jar        = std::make_shared<BatchJar>();
+            jar->jarPath    = jarPaths[i];
+            jar->outPath    = outPaths[i];
+            jar->settings   = &settings;
+            jar->failedJars = &failedJars;
+            configureHunters(jar->hunters, settings);
+
+            pool.submit([&pool, jar] { startJar(pool, jar); });
+        }
+
+        pool.wait();
+
+        std::cout << "Hunted " << jarPaths.size() - failedJars << " of " << jarPaths.size() << " jars." << std::endl;
+        return failedJars;
+    }
+
+    // Write the manifest of every jar into its folder as manifest.json and manifest.jhm, instead of the assets.
+    // Jars are hunted one after another, each inflated on all jobs. Returns the number of jars that failed
+    size_t indexJars(const std::vector<std::filesystem::path>& jarPaths,
+                     const std::vector<std::string>&           outPaths,
+                     const HuntSettings&                       settings,
+                     size_t                                    jobs)
+    {
+        jhunter::hunter::HuntSettings huntSettings {};
+        huntSettings.stream.inflateThreads = jobs;
+        huntSettings.stream.embedded       = settings.embedded;
+        huntSettings.verifyPngCRC          = settings.png.verifyCRC;
+
+        size_t failedJars = 0;
+        for (size_t i = 0; i < jarPaths.size(); ++i)
+        {
+            try
+            {
+                jhunter::io::ZipArchive archive(jarPaths[i].generic_string(), settings.archive);
+                auto                    manifest = jhunter::hunter::buildManifest(archive, huntSettings);
+
+                std::filesystem::create_directories(outPaths[i]);
+                auto          jsonPath = std::filesystem::path(outPaths[i]) / "manifest.json";
+                std::ofstream json(jsonPath);
+                json << manifest.toJson();
+                if (!json)
+                {
+                    std::cerr << "Error: Failed to write manifest: " << jsonPath.generic_string() << std::endl;
+                    throw std::runtime_error("Failed to write manifest.");
+                }
+                manifest.save((std::filesystem::path(outPaths[i]) / "manifest.jhm").string());
+
+                if (!settings.png.quiet)
+                {
+                    std::cout << "Indexed " << manifest.records.size() << " assets of '" << jarPaths[i].generic_string()
+                              << "' into '" << outPaths[i] << "'." << std::endl;
+                }
+            }
+            catch (const std::exception& error)
+            {
+                std::cerr << "Error: Failed to index " << jarPaths[i].generic_string() << ": " << error.what()
+                          << std::endl;
+                ++failedJars;
+            }
+        }
+        return failedJars;
+    }
+
+    // The reply to a server job: what was hunted, or why not, and how long it waited and took in seconds
+    std::string makeJobRecord(const std::string& id, const BatchJar& jar)
+    {
+        auto seconds = [](Clock::duration duration) { return std::chrono::duration<double>(duration).count(); };
+
+        std::ostringstream record;
+        record << std::fixed << std::setprecision(6);
+        record << "{\"id\": " << id;
+        record << ", \"jar\": " << jhunter::cli::quoteJson(jar.jarPath.generic_string());
+        record << ", \"output\": " << jhunter::cli::quoteJson(jar.outPath);
+        record << ", \"ok\": " << (jar.failed ? "false" : "true");
+        if (jar.failed)
+            record << ", \"error\": " << jhunter::cli::quoteJson(jar.error);
+        record << ", \"cached\": " << (jar.restored ? "true" : "false");
+        record << ", \"pngs\": " << jar.pngFiles.size();
+        record << ", \"midis\": " << jar.midiFiles.size();
+        record << ", \"waitSeconds\": " << seconds(jar.started - jar.received);
+        record << ", \"seconds\": " << seconds(Clock::now() - jar.received) << "}";
+        return record.str();
+    }
+
+    // Set by SIGINT and SIGTERM, the server stops taking jobs and finishes the ones it has
+    std::atomic<bool> g_Stopping {false};
+
+    // Hunt the jars of requests as they come in, on one pool with the SoundFont and synths loaded once. A request
+    // is a JSON object on one line, see the README. Every job is answered with a record once its files are on disk.
+    // Serves stdin when target is -, a Unix domain socket otherwise. Returns the number of jobs that failed
+    size_t serve(const std::string& target, const std::string& outRoot, HuntSettings settings, size_t jobs)
+    {
+        shareSynths(settings, jobs);
+
+        // Output folders of the jobs in flight. Two jobs writing into one folder would mix their files and cache
+        // records, so a job for a folder in use is turned away
+        std::mutex                      outPathsMutex;
+        std::unordered_set<std::string> busyOutPaths;
+
+        jhunter::pipeline::TaskPool pool(jobs);
+        std::atomic<size_t>         failedJobs {0};
+
+        auto onLine = [&](const std::string& line, const jhunter::cli::Reply& reply) {
+            auto        received    = Clock::now();
+            auto        jobSettings = std::make_shared<HuntSettings>(settings);
+            std::string id          = "null";
+            std::string jarPath;
+            std::string outPath;
+            std::string outKey;
+            try
+            {
+                auto request = jhunter::cli::parseJsonObject(line);
+                auto find    = [&request](const char* name) -> const jhunter::cli::JsonValue* {
+                    auto it = request.find(name);
+                    return it != request.end() && it->second.text != "null" ? &it->second : nullptr;
+                };
+                auto option = [&find](const char* name, bool current) {
+                    const auto* value = find(name);
+                    if (value && !value->quoted && (value->text == "true" || value->text == "false"))
+                        return value->text == "true";
+                    if (value)
+                        throw std::runtime_error(std::string(name) + ": must be true or false.");
+                    return current;
+                };
+
+                if (const auto* value = find("id"))
+                    id = value->toJson();
+
+                const auto* jar = find("jar");
+                if (!jar || !jar->quoted || jar->text.empty())
+                    throw std::runtime_error("jar: a path is required.");
+                jarPath = jar->text;
+
+                const auto* output = find("output");
+                if (output && !output->quoted)
+                    throw std::runtime_error("output: must be a path.");
+                std::string stem = std::filesystem::path(jarPath).stem().generic_string();
+                outPath          = output ? output->text :
+                                   outRoot.empty() ? stem + "_out" :
+                                                     (std::filesystem::path(outRoot) / stem).string();
+
+                bool verifyCRC = option("verifyPngCrc", settings.png.verifyCRC);
+                bool exportWAV = option("wav", settings.midi.exportWAV) && settings.midi.synthPool;
+                bool embedded  = option("embedded", settings.embedded.has_value());
+                bool prefilter = option("prefilter", settings.archive.filter.has_value());
+                jobSettings->archive.memoryMap = option("mmap", settings.archive.memoryMap);
+
+                // The cache only holds what the options of the server hunt
+                if (verifyCRC != settings.png.verifyCRC || exportWAV != settings.midi.exportWAV ||
+                    embedded != settings.embedded.has_value() || prefilter != settings.archive.filter.has_value())
+                {
+                    jobSettings->cache      = nullptr;
+                    jobSettings->midi.cache = nullptr;
+                }
+
+                jobSettings->png.verifyCRC  = verifyCRC;
+                jobSettings->midi.exportWAV = exportWAV;
+                if (!embedded)
+                    jobSettings->embedded.reset();
+                else if (!jobSettings->embedded)
+                    jobSettings->embedded = jhunter::io::EmbeddedStreamSettings {};
+                if (!prefilter)
+                    jobSettings->archive.filter.reset();
+                else if (!jobSettings->archive.filter)
+                    jobSettings->archive.filter = jhunter::io::EntryFilter {};
+
+                outKey = cacheKeyPath(outPath);
+                std::lock_guard lock(outPathsMutex);
+                if (!busyOutPaths.insert(outKey).second)
+                    throw std::runtime_error("output: " + outPath + " is in use by another job.");
+            }
+            catch (const std::exception& error)
+            {
+                std::cerr << "Error: Bad request: " << error.what() << std::endl;
+                ++failedJobs;
+                reply("{\"id\": " + id + ", \"ok\": false, \"error\": " + jhunter::cli::quoteJson(error.what()) + "}");
+                return;
+            }
+
+            auto jar           = std::make_shared<BatchJar>();
+            jar->jarPath       = jarPath;
+            jar->outPath       = outPath;
+            jar->settings      = jobSettings.get();
+            jar->ownedSettings = jobSettings;
+            jar->failedJars    = &failedJobs;
+            jar->received      = received;
+            jar->onFinished    = [&outPathsMutex, &busyOutPaths, reply, id, outKey](const BatchJar& jar) {
+                {
+                    std::lock_guard lock(outPathsMutex);
+                    busyOutPaths.erase(outKey);
+                }
+                reply(makeJobRecord(id, jar));
+            };
+            configureHunters(jar->hunters, *jobSettings);
+
+            pool.submit([&pool, jar] { startJar(pool, jar); });
+        };
+
+        if (target == "-")
+            jhunter::cli::serveStdin(onLine);
+        else
+            jhunter::cli::serveSocket(target, onLine, g_Stopping);
+
+        // Jobs taken before the stop are still hunted and answered
+        pool.wait();
+        return failedJobs;
+    }
+} // namespace
 
 int main(int argc, char* argv[])
 {
@@ -9,12 +588,160 @@ int main(int argc, char* argv[])
 
     argparse::ArgumentParser program("j2me-asset-hunter");
 
-    program.add_argument("jar").help("a .jar file to handle with.");
-    program.add_argument("-o", "--output_dir").help("the output directory.").default_value("");
+    program.add_argument("jars")
+        .help("the .jar files to handle with, directories and globs (e.g. games/*.jar) hunt every jar they hold.")
+        .nargs(argparse::nargs_pattern::any);
+    program.add_argument("-l", "--list").help("a file with one jar, directory or glob per line.").default_value("");
+    program.add_argument("-o", "--output_dir")
+        .help("the output directory. In batch mode every jar gets a folder named after it in here.")
+        .default_value("");
+    program.add_argument("-j", "--jobs")
+        .help("the number of threads used to decompress entries and render WAVs, 0 for all cores.")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--verify-png-crc")
+        .help("check the CRC of every PNG chunk before accepting a PNG.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--output-format")
+        .help("how assets are written: dir for plain files, zip or tar for a single archive named after the output.")
+        .default_value("dir");
+    program.add_argument("--dedup")
+        .help("save identical assets once, later copies are listed in duplicates.tsv and not rendered again.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--cache")
+        .help("a cache file of earlier results. Unchanged jars are skipped and known MIDIs are not rendered again.")
+        .default_value("");
+    program.add_argument("-q", "--quiet")
+        .help("no line for every saved file, only errors and totals.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--stats")
+        .help("write counters and timings of every stage as JSON to this file when done, - for stdout.")
+        .default_value("");
+    program.add_argument("--embedded")
+        .help("also hunt in zlib and gzip streams found inside entries, such as packed resource files.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--embedded-depth")
+        .help("how many levels of streams inside streams are inflated.")
+        .default_value(2)
+        .scan<'i', int>();
+    program.add_argument("--embedded-raw")
+        .help("also try raw deflate streams without a header. Slow, and finds more false streams.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--embedded-memory")
+        .help("the most MiB inflated from the embedded streams of a single entry.")
+        .default_value(64)
+        .scan<'i', int>();
+    program.add_argument("--embedded-time")
+        .help("the most milliseconds spent on the embedded streams of a single entry.")
+        .default_value(250)
+        .scan<'i', int>();
+    program.add_argument("--stream")
+        .help("write assets while the jar is still being inflated, with bounded memory.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--memory-limit")
+        .help("the approximate memory cap of the streaming mode in MiB.")
+        .default_value(256)
+        .scan<'i', int>();
+    program.add_argument("--wav-max-length")
+        .help("the most seconds of audio rendered into a WAV, 0 for no limit.")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--wav-time-limit")
+        .help("the most seconds a single WAV may take to render, 0 for no limit.")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--wav-silence-cutoff")
+        .help("end a WAV after this many milliseconds of silence following the last sound, 0 to render to the end.")
+        .default_value(0)
+        .scan<'i', int>();
+    program.add_argument("--wav-loops")
+        .help("how many times a MIDI is played into its WAV, for tunes made to loop.")
+        .default_value(1)
+        .scan<'i', int>();
+    program.add_argument("--wav-rate")
+        .help("the sample rate of the WAVs in Hz.")
+        .default_value(44100)
+        .scan<'i', int>();
+    program.add_argument("--wav-channels")
+        .help("the channels of the WAVs, 1 for mono or 2 for stereo.")
+        .default_value(2)
+        .scan<'i', int>();
+    program.add_argument("--wav-bits")
+        .help("the bits per sample of the WAVs, 16 for integer or 32 for float samples.")
+        .default_value(16)
+        .scan<'i', int>();
+    program.add_argument("--polyphony")
+        .help("the most voices the synth plays at once.")
+        .default_value(256)
+        .scan<'i', int>();
+    program.add_argument("--interpolation")
+        .help("the synth interpolation: none, linear, 4th or 7th.")
+        .default_value("4th");
+    program.add_argument("--float-render")
+        .help("render in float and convert to 16 bits with dither instead of rendering 16-bit samples directly.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--no-dither")
+        .help("convert float renders to 16 bits without dither.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--mmap")
+        .help("map jars into memory and hunt in stored entries in place instead of copying them out.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--prefilter")
+        .help("skip class files, META-INF and encrypted entries without inflating them.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--index-only")
+        .help("write a manifest of the assets of every jar (manifest.json and manifest.jhm) instead of the assets.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--serve")
+        .help("keep running and hunt the jars of JSON requests, one per line, read from this Unix socket or - for "
+              "stdin.")
+        .default_value("");
 
+    std::vector<std::string> inputs;
     try
     {
         program.parse_args(argc, argv);
+
+        inputs = program.present<std::vector<std::string>>("jars").value_or(std::vector<std::string> {});
+        if (inputs.empty() && program.get("--list").empty() && program.get("--serve").empty())
+        {
+            throw std::runtime_error("jars: at least one jar, directory, glob or --list is required.");
+        }
+
+        auto outputFormat = program.get("--output-format");
+        if (outputFormat != "dir" && outputFormat != "zip" && outputFormat != "tar")
+        {
+            throw std::runtime_error("--output-format: must be dir, zip or tar.");
+        }
+
+        auto wavChannels = program.get<int>("--wav-channels");
+        if (wavChannels != 1 && wavChannels != 2)
+        {
+            throw std::runtime_error("--wav-channels: must be 1 or 2.");
+        }
+
+        auto wavBits = program.get<int>("--wav-bits");
+        if (wavBits != 16 && wavBits != 32)
+        {
+            throw std::runtime_error("--wav-bits: must be 16 or 32.");
+        }
+
+        auto interpolation = program.get("--interpolation");
+        if (interpolation != "none" && interpolation != "linear" && interpolation != "4th" && interpolation != "7th")
+        {
+            throw std::runtime_error("--interpolation: must be none, linear, 4th or 7th.");
+        }
     }
     catch (const std::exception& err)
     {
@@ -23,31 +750,276 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    auto jarFilePath = program.get("jar");
-    auto jarFileName = std::filesystem::path(jarFilePath).stem().generic_string();
+    size_t jobs = std::max(program.get<int>("--jobs"), 0);
+    if (jobs == 0)
+    {
+        jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    HuntSettings settings {};
+    settings.png.verifyCRC      = program.get<bool>("--verify-png-crc");
+    settings.png.quiet          = program.get<bool>("--quiet") || program.get("--serve") == "-";
+    settings.midi.quiet         = settings.png.quiet;
+    settings.midi.soundFontPath = (workingDir / "assets/default.sf2").generic_string();
+    settings.midi.renderThreads = jobs;
+
+    settings.midi.maxRenderDuration = std::chrono::seconds(std::max(program.get<int>("--wav-max-length"), 0));
+    settings.midi.renderTimeBudget  = std::chrono::seconds(std::max(program.get<int>("--wav-time-limit"), 0));
+    settings.midi.silenceCutoff     = std::chrono::milliseconds(std::max(program.get<int>("--wav-silence-cutoff"), 0));
+    settings.midi.loopCount         = std::max(program.get<int>("--wav-loops"), 1);
+
+    auto interpolation                = program.get("--interpolation");
+    settings.midi.synth.sampleRate    = std::clamp(program.get<int>("--wav-rate"), 8000, 96000);
+    settings.midi.synth.polyphony     = std::clamp(program.get<int>("--polyphony"), 1, 65535);
+    settings.midi.synth.interpolation = interpolation == "none"     ? FLUID_INTERP_NONE
+                                        : interpolation == "linear" ? FLUID_INTERP_LINEAR
+                                        : interpolation == "7th"    ? FLUID_INTERP_7THORDER
+                                                                    : FLUID_INTERP_4THORDER;
+    settings.midi.channels            = program.get<int>("--wav-channels");
+    settings.midi.bitsPerSample       = program.get<int>("--wav-bits");
+    settings.midi.floatRender         = program.get<bool>("--float-render");
+    settings.midi.dither              = !program.get<bool>("--no-dither");
+
+    settings.archive.memoryMap = program.get<bool>("--mmap");
+    if (program.get<bool>("--prefilter"))
+    {
+        settings.archive.filter = jhunter::io::EntryFilter {};
+    }
+
+    if (program.get<bool>("--embedded"))
+    {
+        jhunter::io::EmbeddedStreamSettings embedded {};
+        embedded.maxDepth       = static_cast<size_t>(std::max(program.get<int>("--embedded-depth"), 0));
+        embedded.maxOutputBytes = static_cast<size_t>(std::max(program.get<int>("--embedded-memory"), 0)) << 20;
+        embedded.timeBudget     = std::chrono::milliseconds(std::max(program.get<int>("--embedded-time"), 0));
+        embedded.rawDeflate     = program.get<bool>("--embedded-raw");
+        settings.embedded       = embedded;
+    }
+
+    // One table for everything hunted, so duplicates are found across hunters and jars
+    std::shared_ptr<jhunter::hunter::AssetDedup> dedup;
+    if (program.get<bool>("--dedup"))
+    {
+        dedup               = std::make_shared<jhunter::hunter::AssetDedup>();
+        settings.png.dedup  = dedup;
+        settings.midi.dedup = dedup;
+    }
+
+    std::string outPath      = program.get("-o");
+    std::string outputFormat = program.get("--output-format");
+    std::string serveTarget  = program.get("--serve");
+    bool        serving      = !serveTarget.empty();
 
-    std::string outPath = program.get("-o");
-    if (outPath.empty())
+    // Several jars share one pool of threads and synths instead of one process each
+    bool batch = !serving &&
+                 (inputs.size() != 1 || !program.get("--list").empty() || jhunter::cli::isMultiInput(inputs[0]));
+
+    auto jarFilePath = inputs.empty() ? std::string() : inputs[0];
+    if (!batch && outPath.empty())
+    {
+        outPath = std::filesystem::path(jarFilePath).stem().generic_string() + "_out";
+    }
+
+    // Nothing but the manifests is written, so no sink, cache or synth is set up
+    if (program.get<bool>("--index-only"))
+    {
+        if (program.get<bool>("--stream") || serving)
+        {
+            std::cerr << "Error: --index-only can not be combined with --stream or --serve." << std::endl;
+            return 1;
+        }
+
+        auto jarPaths = batch ? jhunter::cli::collectInputs(inputs, program.get("--list")) :
+                                std::vector<std::filesystem::path> {jarFilePath};
+        auto outPaths = batch ? makeBatchOutPaths(jarPaths, outPath) : std::vector<std::string> {outPath};
+        return indexJars(jarPaths, outPaths, settings, jobs) == 0 ? 0 : 1;
+    }
+
+    // Every saved file goes through one sink, which writes on its own thread. Archives are named after the
+    // output directory and hold the files under their paths relative to it
+    std::shared_ptr<jhunter::hunter::OutputSink> sink;
+    if (outputFormat == "dir")
+    {
+        // A server writes on the workers, so a job is only answered once its files are on disk
+        sink = std::make_shared<jhunter::hunter::DirectorySink>(!serving);
+    }
+    else
+    {
+        if (program.get<bool>("--stream") || !program.get("--cache").empty() || serving)
+        {
+            std::cerr << "Error: --stream, --cache and --serve need the dir output format." << std::endl;
+            return 1;
+        }
+
+        std::string extension   = "." + outputFormat;
+        std::string archivePath = outPath.empty() ? "batch_out" + extension : outPath;
+        std::string basePath    = outPath;
+        if (std::filesystem::path(archivePath).extension() == extension)
+            basePath = std::filesystem::path(archivePath).replace_extension().generic_string();
+        else
+            archivePath += extension;
+
+        if (outputFormat == "zip")
+            sink = std::make_shared<jhunter::hunter::ZipSink>(archivePath, basePath);
+        else
+            sink = std::make_shared<jhunter::hunter::TarSink>(archivePath, basePath);
+        outPath = basePath;
+    }
+    settings.png.sink  = sink;
+    settings.midi.sink = sink;
+
+    // Anything that changes what a hunt writes invalidates the cache
+    if (!program.get("--cache").empty())
+    {
+        std::error_code error;
+        auto            soundFontSize = std::filesystem::file_size(settings.midi.soundFontPath, error);
+        auto            soundFontTime = std::filesystem::last_write_time(settings.midi.soundFontPath, error);
+
+        std::string settingsKey = "png-crc=" + std::to_string(settings.png.verifyCRC) +
+                                  ";wav=" + std::to_string(settings.midi.exportWAV) + ":" +
+                                  std::to_string(settings.midi.maxRenderDuration.count()) + ":" +
+                                  std::to_string(settings.midi.renderTimeBudget.count()) + ":" +
+                                  std::to_string(settings.midi.silenceCutoff.count()) + ":" +
+                                  std::to_string(settings.midi.loopCount) + ":" +
+                                  std::to_string(settings.midi.synth.sampleRate) + ":" +
+                                  std::to_string(settings.midi.synth.polyphony) + ":" +
+                                  std::to_string(settings.midi.synth.interpolation) + ":" +
+                                  std::to_string(settings.midi.channels) + ":" +
+                                  std::to_string(settings.midi.bitsPerSample) + ":" +
+                                  std::to_string(settings.midi.floatRender) + ":" +
+                                  std::to_string(settings.midi.dither) +
+                                  ";dedup=" + std::to_string(dedup != nullptr) + ";embedded=" +
+                                  (settings.embedded ? std::to_string(settings.embedded->maxDepth) + ":" +
+                                                           std::to_string(settings.embedded->maxOutputBytes) + ":" +
+                                                           std::to_string(settings.embedded->timeBudget.count()) +
+                                                           ":" + std::to_string(settings.embedded->rawDeflate)
+                                                     : std::string("off")) +
+                                  ";prefilter=" + std::to_string(settings.archive.filter.has_value()) +
+                                  ";soundfont=" + std::to_string(soundFontSize) + ":" +
+                                  std::to_string(soundFontTime.time_since_epoch().count());
+
+        settings.cache = std::make_shared<jhunter::hunter::ResultCache>(
+            program.get("--cache"), jhunter::hunter::ResultCache::makeSettingsKey(settingsKey));
+        settings.midi.cache = settings.cache;
+    }
+
+    // List the skipped duplicates next to where they would have been saved, wait for the writes, remember what was
+    // hunted and report where the time went
+    auto finish = [&dedup, &sink, &settings, &serveTarget, statsPath = program.get("--stats")] {
+        if (dedup)
+        {
+            // When serving stdin, stdout carries nothing but replies
+            dedup->writeManifests(*sink);
+            (serveTarget == "-" ? std::cerr : std::cout)
+                << dedup->getDuplicateCount() << " duplicate assets skipped." << std::endl;
+        }
+        sink->finish();
+        if (settings.cache)
+        {
+            settings.cache->save();
+        }
+
+        // Written last, so the writes still queued in the sink are counted
+        if (statsPath == "-")
+        {
+            std::cout << jhunter::stats::getStats().toJson() << std::flush;
+        }
+        else if (!statsPath.empty())
+        {
+            std::ofstream statsFile(statsPath);
+            statsFile << jhunter::stats::getStats().toJson();
+            if (!statsFile)
+            {
+                std::cerr << "Error: Failed to write stats: " << statsPath << std::endl;
+            }
+        }
+    };
+
+    if (serving)
+    {
+        if (program.get<bool>("--stream") || !inputs.empty() || !program.get("--list").empty())
+        {
+            std::cerr << "Error: --serve takes its jars from requests and can not be combined with jars or --stream."
+                      << std::endl;
+            return 1;
+        }
+
+        // A socket server stops taking jobs on Ctrl+C or a kill and finishes the ones it took. On stdin, the end of
+        // the input does the same
+        if (serveTarget != "-")
+        {
+            std::signal(SIGINT, [](int) { g_Stopping = true; });
+            std::signal(SIGTERM, [](int) { g_Stopping = true; });
+        }
+
+        size_t failedJobs = serve(serveTarget, outPath, settings, jobs);
+        finish();
+        std::cerr << "Served with " << failedJobs << " failed jobs." << std::endl;
+        return 0;
+    }
+
+    if (batch)
     {
-        outPath = jarFileName + "_out";
+        if (program.get<bool>("--stream"))
+        {
+            std::cerr << "Error: --stream hunts a single jar and can not be combined with a batch." << std::endl;
+            return 1;
+        }
+
+        auto   jarPaths   = jhunter::cli::collectInputs(inputs, program.get("--list"));
+        size_t failedJars = huntBatch(jarPaths, outPath, settings, jobs);
+        finish();
+        return failedJars == 0 ? 0 : 1;
     }
 
-    jhunter::hunter::PngHunter pngHunter;
+    // Both hunters share one fused scan per buffer
+    Hunters hunters;
+    configureHunters(hunters, settings);
+
+    auto& pngHunter  = hunters.get<jhunter::hunter::PngHunter>();
+    auto& midiHunter = hunters.get<jhunter::hunter::MidiHunter>();
+
+    jhunter::io::ZipArchive archive(jarFilePath, settings.archive);
 
-    jhunter::hunter::MidiHunter         midiHunter;
-    jhunter::hunter::MidiHunterSettings midiSettings {};
-    midiSettings.soundFontPath = (workingDir / "assets/default.sf2").generic_string();
-    midiHunter.setSettings(midiSettings);
+    if (program.get<bool>("--stream"))
+    {
+        // Streamed assets are written as they are found and never collected, so only renders are reused
+        jhunter::pipeline::StreamSettings streamSettings {};
+        streamSettings.memoryLimit    = static_cast<size_t>(std::max(program.get<int>("--memory-limit"), 1)) << 20;
+        streamSettings.inflateThreads = jobs;
+        streamSettings.embedded       = settings.embedded;
+        hunters.huntStreaming(archive, outPath, {"image_", "audio_"}, streamSettings);
+        finish();
+        return 0;
+    }
+
+    uint64_t fingerprint = settings.cache ? archive.getFingerprint() : 0;
+    if (restoreJar(settings, jarFilePath, fingerprint, outPath))
+    {
+        finish();
+        return 0;
+    }
 
-    jhunter::io::ZipArchive archive(jarFilePath);
+    // Entries are inflated in parallel but come back in archive order, so asset numbering is stable. Embedded
+    // streams follow the entry they were found in. All of it lives in one arena, released with the last buffer
+    auto arena   = std::make_shared<jhunter::memory::Arena>();
+    auto buffers = archive.readAllEntries(jobs, arena);
 
-    auto entries = archive.listEntries();
-    for (const auto& entry : entries)
+    std::vector<std::vector<jhunter::io::Buffer>> embedded;
+    if (settings.embedded)
     {
-        auto buffer = archive.readFile(entry);
-        pngHunter.addSourceBuffer(buffer);
-        midiHunter.addSourceBuffer(buffer);
+        embedded = inflateEmbedded(buffers, *settings.embedded, arena.get(), jobs);
     }
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        hunters.addSourceBuffer(std::move(buffers[i]));
+        if (i < embedded.size())
+        {
+            for (auto& stream : embedded[i])
+                hunters.addEmbeddedBuffer(jhunter::hunter::makeSharedBuffer(std::move(stream), arena));
+        }
+    }
+    arena.reset();
 
     auto pngFiles = pngHunter.parseFiles();
     pngHunter.saveFiles(pngFiles, outPath, "image_");
@@ -55,5 +1027,11 @@ int main(int argc, char* argv[])
     auto midiFiles = midiHunter.parseFiles();
     midiHunter.saveFiles(midiFiles, outPath, "audio_");
 
+    if (settings.cache)
+    {
+        settings.cache->storeJar(makeJarRecord(settings, jarFilePath, fingerprint, outPath, pngFiles, midiFiles));
+    }
+    finish();
+
     return 0;
-}
\ No newline at end of file
+}
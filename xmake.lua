@@ -12,6 +12,10 @@ option("examples") -- build examples?
     set_default(true)
 option_end()
 
+option("benchmarks") -- build benchmarks?
+    set_default(false)
+option_end()
+
 -- if build on windows
 if is_plat("windows") then
     add_cxxflags("/EHsc")
@@ -50,7 +54,7 @@ add_rules("plugin.compile_commands.autoupdate", {outputdir = ".vscode"})
 add_repositories("my-xmake-repo https://github.com/zzxzzk115/xmake-repo.git dev")
 
 -- add requirements
-add_requires("argparse", "libzip", "fluidsynth")
+add_requires("argparse", "libzip", "fluidsynth", "zlib")
 
 -- target defination, name: j2me-asset-hunter-static-lib
 target("j2me-asset-hunter-static-lib")
@@ -68,6 +72,7 @@ target("j2me-asset-hunter-static-lib")
     add_packages("argparse", { public = true })
     add_packages("libzip", { public = true })
     add_packages("fluidsynth", { public = true })
+    add_packages("zlib", { public = true })
 
 -- target defination, name: j2me-asset-hunter
 target("j2me-asset-hunter")
@@ -92,6 +97,11 @@ if has_config("examples") then
     includes("examples")
 end
 
+-- if build benchmarks, then include benchmarks
+if has_config("benchmarks") then
+    includes("benchmarks")
+end
+
 -- pack
 includes("@builtin/xpack")
 